@@ -0,0 +1,68 @@
+/*
+ * Simple file manager for Commodore 64.
+ * Copyright (C) 2019 Łukasz Szpakowski
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stddef.h>
+#include <stdlib.h>
+#include "arena.h"
+
+void arena_init(struct arena *arena, unsigned chunk_size)
+{
+  arena->first_chunk = NULL;
+  arena->last_chunk = NULL;
+  arena->chunk_size = chunk_size;
+}
+
+/*
+ * Allocates the memory from the last chunk. A new chunk is allocated if the last chunk hasn't
+ * enough free memory. Returns NULL if there isn't enough memory.
+ */
+void *arena_alloc(struct arena *arena, unsigned size)
+{
+  struct arena_chunk *chunk = arena->last_chunk;
+  void *p;
+  if(chunk == NULL || chunk->size - chunk->used < size) {
+    unsigned chunk_size = size > arena->chunk_size ? size : arena->chunk_size;
+    chunk = malloc(sizeof(struct arena_chunk) + chunk_size);
+    if(chunk == NULL) return NULL;
+    chunk->next = NULL;
+    chunk->size = chunk_size;
+    chunk->used = 0;
+    if(arena->last_chunk != NULL)
+      arena->last_chunk->next = chunk;
+    else
+      arena->first_chunk = chunk;
+    arena->last_chunk = chunk;
+  }
+  p = arena_chunk_data(chunk) + chunk->used;
+  chunk->used += size;
+  return p;
+}
+
+/*
+ * Releases all memory of the arena in one step.
+ */
+void arena_free(struct arena *arena)
+{
+  struct arena_chunk *chunk = arena->first_chunk;
+  while(chunk != NULL) {
+    struct arena_chunk *next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  arena->first_chunk = NULL;
+  arena->last_chunk = NULL;
+}
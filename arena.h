@@ -0,0 +1,46 @@
+/*
+ * Simple file manager for Commodore 64.
+ * Copyright (C) 2019 Łukasz Szpakowski
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _ARENA_H
+#define _ARENA_H
+
+/*
+ * An arena allocates memory from chunks that are allocated by malloc. Allocated memory is never
+ * moved and is released only with the whole arena, so the heap isn't fragmented by many small
+ * allocations and reallocations.
+ */
+struct arena_chunk
+{
+  struct arena_chunk *next;
+  unsigned size;
+  unsigned used;
+};
+
+struct arena
+{
+  struct arena_chunk *first_chunk;
+  struct arena_chunk *last_chunk;
+  unsigned chunk_size;
+};
+
+void arena_init(struct arena *arena, unsigned chunk_size);
+void *arena_alloc(struct arena *arena, unsigned size);
+void arena_free(struct arena *arena);
+
+#define arena_chunk_data(chunk)         ((char *) ((chunk) + 1))
+
+#endif
@@ -142,3 +142,14 @@ void cmd_channel_close(unsigned device)
   if(cmd_channel->count == 1) cbm_close(cmd_channel->lfn);
   if(cmd_channel->count > 0) cmd_channel->count--;
 }
+
+int cmd_channel_execute(unsigned char device, const char *cmd, const char **msg)
+{
+  int res;
+  res = cmd_channel_write(device, cmd, 1);
+  if(res == -1) return -1;
+  res = cmd_channel_read(device, msg, 0);
+  if(res == -1) return -1;
+  cmd_channel_close(device);
+  return res;
+}
@@ -24,5 +24,6 @@ void finalize_cmd_channels(void);
 int cmd_channel_read(unsigned char device, const char **msg, char must_open);
 int cmd_channel_write(unsigned char device, const char *cmd, char must_open);
 void cmd_channel_close(unsigned device);
+int cmd_channel_execute(unsigned char device, const char *cmd, const char **msg);
 
 #endif
@@ -25,11 +25,29 @@
 #include "util.h"
 
 #define ABOUT_DIALOG_LABEL_COUNT        5
+#define LIST_DIALOG_VIEW_HEIGHT         12
+#define SAVED_SCREEN_SIZE               (SCREEN_WIDTH * SCREEN_HEIGHT * 2)
+
+/*
+ * A screen area under a dialog. The area is saved when the dialog is drawn first time and is restored
+ * when the dialog is closed, so the screen under the dialog isn't drawn again. Saved areas are stacked,
+ * so a dialog can be opened over other dialog.
+ */
+struct dialog_area
+{
+  unsigned char x;
+  unsigned char y;
+  unsigned char width;
+  unsigned char height;
+  char is_open;
+  char is_saved;
+};
 
 struct input_dialog
 {
   unsigned char width;
   unsigned char height;
+  struct dialog_area area;
   const char *title;
   const struct input *inputs;
   unsigned char input_count;
@@ -40,15 +58,18 @@ struct progress_dialog
 {
   unsigned char width;
   unsigned char height;
+  struct dialog_area area;
   const char *title;
   const struct progress *progresses;
   unsigned char progress_count;
+  const char *info;
 };
 
 struct message_dialog
 {
   unsigned char width;
   unsigned char height;
+  struct dialog_area area;
   const char *title;
   const char *message;
   unsigned char focus_index;
@@ -58,204 +79,249 @@ struct yes_no_dialog
 {
   unsigned char width;
   unsigned char height;
+  struct dialog_area area;
   const char *title;
   const char *message;
   unsigned char focus_index;
 };
 
+struct help_dialog
+{
+  unsigned char width;
+  unsigned char height;
+  struct dialog_area area;
+  const char *title;
+  const char **labels;
+  unsigned char label_count;
+  unsigned char focus_index;
+};
+
 struct about_dialog
 {
   unsigned char width;
   unsigned char height;
+  struct dialog_area area;
   const char *title;
   const char *labels[ABOUT_DIALOG_LABEL_COUNT];
   unsigned char focus_index;
 };
 
+struct list_dialog
+{
+  unsigned char width;
+  unsigned char height;
+  struct dialog_area area;
+  const char *title;
+  const char **labels;
+  unsigned label_count;
+  unsigned view_y;
+  unsigned cursor_y;
+};
+
 static struct input_dialog input_dialog;
 static struct progress_dialog progress_dialog;
 static struct message_dialog message_dialog;
 static struct yes_no_dialog yes_no_dialog;
+static struct help_dialog help_dialog;
+static struct list_dialog list_dialog;
 static struct about_dialog about_dialog;
+static unsigned char saved_screen[SAVED_SCREEN_SIZE];
+static unsigned saved_screen_size;
 
 void initialize_dialogs(void)
 {
   unsigned char i;
   input_dialog.width = 0;
   input_dialog.height = 0;
+  input_dialog.area.is_open = 0;
   input_dialog.title = NULL;
   input_dialog.inputs = NULL;
   input_dialog.input_count = 0;
   input_dialog.focus_index = 0;
   progress_dialog.width = 0;
   progress_dialog.height = 0;
+  progress_dialog.area.is_open = 0;
   progress_dialog.title = NULL;
   progress_dialog.progresses = NULL;
   progress_dialog.progress_count = 0;
+  progress_dialog.info = NULL;
   message_dialog.width = 0;
   message_dialog.height = 0;
+  message_dialog.area.is_open = 0;
   message_dialog.title = NULL;
   message_dialog.message = NULL;
   message_dialog.focus_index = 0;
   yes_no_dialog.width = 0;
   yes_no_dialog.height = 0;
+  yes_no_dialog.area.is_open = 0;
   yes_no_dialog.title = NULL;
   yes_no_dialog.message = NULL;
   yes_no_dialog.focus_index = 0;
+  help_dialog.width = 0;
+  help_dialog.height = 0;
+  help_dialog.area.is_open = 0;
+  help_dialog.title = NULL;
+  help_dialog.labels = NULL;
+  help_dialog.label_count = 0;
+  help_dialog.focus_index = 0;
+  list_dialog.width = 0;
+  list_dialog.height = 0;
+  list_dialog.area.is_open = 0;
+  list_dialog.title = NULL;
+  list_dialog.labels = NULL;
+  list_dialog.label_count = 0;
+  list_dialog.view_y = 0;
+  list_dialog.cursor_y = 0;
   about_dialog.width = 0;
   about_dialog.height = 0;
+  about_dialog.area.is_open = 0;
   about_dialog.title = NULL;
   for(i = 0; i < ABOUT_DIALOG_LABEL_COUNT; i++) {
     about_dialog.labels[i] = NULL;
   }
   about_dialog.focus_index = 0;
+  saved_screen_size = 0;
 }
 
 void finalize_dialogs(void) {}
 
-static void draw_button(const char *label, char is_focused)
+static void open_area(struct dialog_area *area, unsigned char width, unsigned char height)
 {
-  unsigned char len = strlen(label);
-  unsigned char i, n = center(6, len);
-  revers(!is_focused);
-  textcolor(SCREEN_COLOR_FOREGROUND);
-  for(i = 0; i < n; i++) {
-    cputc(' ');
+  unsigned size = width * height * 2;
+  if(area->is_open) return;
+  area->x = center_x(width);
+  area->y = center_y(height);
+  area->width = width;
+  area->height = height;
+  area->is_open = 1;
+  area->is_saved = (saved_screen_size + size <= SAVED_SCREEN_SIZE);
+  if(area->is_saved) {
+    screen_save(area->x, area->y, width, height, saved_screen + saved_screen_size);
+    saved_screen_size += size;
   }
-  cputs(label);
-  for(i = 0; i < 6 - n - len; i++) {
-    cputc(' ');
+}
+
+static void close_area(struct dialog_area *area)
+{
+  if(!area->is_open) return;
+  if(area->is_saved) {
+    saved_screen_size -= area->width * area->height * 2;
+    screen_restore(area->x, area->y, area->width, area->height, saved_screen + saved_screen_size);
   }
-  revers(1);
-  textcolor(SCREEN_COLOR_CURSOR);
+  area->is_open = 0;
+}
+
+static void draw_button(const char *label, char is_focused)
+{
+  unsigned char len = strlen(label);
+  unsigned char n = center(6, len);
+  screen_revers(!is_focused);
+  screen_color(SCREEN_COLOR_FOREGROUND);
+  screen_fill(' ', n);
+  screen_puts(label);
+  screen_fill(' ', 6 - n - len);
+  screen_revers(1);
+  screen_color(SCREEN_COLOR_CURSOR);
 }
 
 static void draw_title(const char *title, unsigned char width)
 {
   unsigned char len = strlen(title);
-  unsigned char i, n = center(width, len);
-  revers(1);
-  textcolor(SCREEN_COLOR_CURSOR);
-  for(i = 0; i < n; i++) {
-    cputc(' ');
-  }
-  safely_cputs(title);
-  for(i = 0; i < width - n - len; i++) {
-    cputc(' ');
-  }
-  revers(0);
-  textcolor(SCREEN_COLOR_FOREGROUND);
+  unsigned char n = center(width, len);
+  screen_revers(1);
+  screen_color(SCREEN_COLOR_CURSOR);
+  screen_fill(' ', n);
+  screen_puts(title);
+  screen_fill(' ', width - n - len);
+  screen_revers(0);
+  screen_color(SCREEN_COLOR_FOREGROUND);
 }
 
 static void draw_label(const char *label, unsigned char width)
 {
-  unsigned char i, len = strlen(label);
-  revers(1);
-  textcolor(SCREEN_COLOR_CURSOR);
-  cputc(' ');
-  safely_cputs(label);
-  for(i = 0; i < width - len - 1; i++) {
-    cputc(' ');
-  }
-  revers(0);
-  textcolor(SCREEN_COLOR_FOREGROUND);
+  unsigned char len = strlen(label);
+  screen_revers(1);
+  screen_color(SCREEN_COLOR_CURSOR);
+  screen_putc(' ');
+  screen_puts(label);
+  screen_fill(' ', width - len - 1);
+  screen_revers(0);
+  screen_color(SCREEN_COLOR_FOREGROUND);
 }
 
 static void draw_text(char *text, unsigned max_text_len, unsigned char width, char is_focused)
 {
-  unsigned char i, len = strlen(text);
-  revers(1);
-  textcolor(SCREEN_COLOR_CURSOR);
-  cputc(' ');
-  revers(0);
-  textcolor(SCREEN_COLOR_FOREGROUND);
-  safely_cputs(text);
+  unsigned char len = strlen(text);
+  screen_revers(1);
+  screen_color(SCREEN_COLOR_CURSOR);
+  screen_putc(' ');
+  screen_revers(0);
+  screen_color(SCREEN_COLOR_FOREGROUND);
+  screen_puts(text);
   if(is_focused) {
-    revers(1);
-    cputc(' ');
-    revers(0);
+    screen_revers(1);
+    screen_putc(' ');
+    screen_revers(0);
   } else {
-    cputc(' ');
-  }
-  for(i = 0; i < max_text_len + 1 - len - 1; i++) {
-    cputc(' ');
+    screen_putc(' ');
   }
-  revers(1);
-  textcolor(SCREEN_COLOR_CURSOR);
-  for(i = 0; i < width - max_text_len - 1 - 1; i++) {
-    cputc(' ');
-  }
-  revers(0);
-  textcolor(SCREEN_COLOR_FOREGROUND);
+  screen_fill(' ', max_text_len + 1 - len - 1);
+  screen_revers(1);
+  screen_color(SCREEN_COLOR_CURSOR);
+  screen_fill(' ', width - max_text_len - 1 - 1);
+  screen_revers(0);
+  screen_color(SCREEN_COLOR_FOREGROUND);
 }
 
 static void draw_empty(unsigned char width)
 {
-  unsigned char i;
-  revers(1);
-  textcolor(SCREEN_COLOR_CURSOR);
-  for(i = 0; i < width; i++) {
-    cputc(' ');
-  }
-  revers(0);
-  textcolor(SCREEN_COLOR_FOREGROUND);
+  screen_revers(1);
+  screen_color(SCREEN_COLOR_CURSOR);
+  screen_fill(' ', width);
+  screen_revers(0);
+  screen_color(SCREEN_COLOR_FOREGROUND);
 }
 
 static void draw_one_button(const char *label, unsigned char width, char is_focused)
 {
-  unsigned char i, n = center(width, 6);
-  revers(1);
-  textcolor(SCREEN_COLOR_CURSOR);
-  for(i = 0; i < n; i++) {
-    cputc(' ');
-  }
+  unsigned char n = center(width, 6);
+  screen_revers(1);
+  screen_color(SCREEN_COLOR_CURSOR);
+  screen_fill(' ', n);
   draw_button(label, is_focused);
-  for(i = 0; i < width - 6 - n; i++) {
-    cputc(' ');
-  }
-  revers(0);
-  textcolor(SCREEN_COLOR_FOREGROUND);  
+  screen_fill(' ', width - 6 - n);
+  screen_revers(0);
+  screen_color(SCREEN_COLOR_FOREGROUND);  
 }
 
 static void draw_two_buttons(const char *label1, const char *label2, unsigned char width, char is_focused1, char is_focused2)
 {
-  unsigned char i, n = center(width, 12 + 2);
-  revers(1);
-  textcolor(SCREEN_COLOR_CURSOR);
-  for(i = 0; i < n; i++) {
-    cputc(' ');
-  }
+  unsigned char n = center(width, 12 + 2);
+  screen_revers(1);
+  screen_color(SCREEN_COLOR_CURSOR);
+  screen_fill(' ', n);
   draw_button(label1, is_focused1);
-  cputs("  ");
+  screen_puts("  ");
   draw_button(label2, is_focused2);
-  for(i = 0; i < width - 12 - 2 - n; i++) {
-    cputc(' ');
-  }
-  revers(0);
-  textcolor(SCREEN_COLOR_FOREGROUND);  
+  screen_fill(' ', width - 12 - 2 - n);
+  screen_revers(0);
+  screen_color(SCREEN_COLOR_FOREGROUND);  
 }
 
 static void draw_progress(unsigned count, unsigned max, unsigned char width)
 {
-  unsigned char i;
-  revers(1);
-  textcolor(SCREEN_COLOR_CURSOR);
-  cputc(' ');
-  textcolor(SCREEN_COLOR_FOREGROUND);
-  for(i = 0; i < count; i++) {
-    cputc(' ');
-  }
-  revers(0);
-  for(i = 0; i < max - count; i++) {
-    cputc(' ');
-  }
-  revers(1);
-  textcolor(SCREEN_COLOR_CURSOR);
-  for(i = 0; i < width - max - 1; i++) {
-    cputc(' ');
-  }
-  revers(0);
-  textcolor(SCREEN_COLOR_FOREGROUND);  
+  screen_revers(1);
+  screen_color(SCREEN_COLOR_CURSOR);
+  screen_putc(' ');
+  screen_color(SCREEN_COLOR_FOREGROUND);
+  screen_fill(' ', count);
+  screen_revers(0);
+  screen_fill(' ', max - count);
+  screen_revers(1);
+  screen_color(SCREEN_COLOR_CURSOR);
+  screen_fill(' ', width - max - 1);
+  screen_revers(0);
+  screen_color(SCREEN_COLOR_FOREGROUND);  
 }
 
 static void draw_message(const char *msg, unsigned char width)
@@ -293,31 +359,58 @@ void input_dialog_draw(void)
   unsigned char x = center_x(input_dialog.width);
   unsigned char y = center_y(input_dialog.height);
   char is_focused1, is_focused2;
-  gotoxy(x, y);
+  open_area(&(input_dialog.area), input_dialog.width, input_dialog.height);
+  screen_goto(x, y);
   draw_title(input_dialog.title, input_dialog.width);
   y++;
   for(i = 0; i < input_dialog.input_count; i++, y += 3) {
     const struct input *input = &(input_dialog.inputs[i]);
     char is_focused = (i == input_dialog.focus_index);
-    gotoxy(x, y);
+    screen_goto(x, y);
     draw_empty(input_dialog.width);
-    gotoxy(x , y + 1);
+    screen_goto(x , y + 1);
     draw_label(input->label, input_dialog.width);
-    gotoxy(x , y + 2);
+    screen_goto(x , y + 2);
     draw_text(input->text, input->max_text_len, input_dialog.width, is_focused);
   }
-  gotoxy(x, y);
+  screen_goto(x, y);
   draw_empty(input_dialog.width);
   y++;
-  gotoxy(x, y);
+  screen_goto(x, y);
   is_focused1 = (input_dialog.input_count == input_dialog.focus_index);
   is_focused2 = (input_dialog.input_count + 1 == input_dialog.focus_index);
   draw_two_buttons("OK", "Cancel", input_dialog.width, is_focused1, is_focused2);
   y++;
-  gotoxy(x, y);
+  screen_goto(x, y);
   draw_empty(input_dialog.width);
 }
 
+/*
+ * Draws only the widget of the input dialog. The widget is the text of the input or the row of the
+ * buttons.
+ */
+static void draw_input_widget(unsigned char i)
+{
+  unsigned char x = input_dialog.area.x;
+  unsigned char count = input_dialog.input_count;
+  if(i < count) {
+    const struct input *input = &(input_dialog.inputs[i]);
+    screen_goto(x, input_dialog.area.y + 1 + i * 3 + 2);
+    draw_text(input->text, input->max_text_len, input_dialog.width, i == input_dialog.focus_index);
+  } else {
+    screen_goto(x, input_dialog.area.y + 1 + count * 3 + 1);
+    draw_two_buttons("OK", "Cancel", input_dialog.width, count == input_dialog.focus_index, count + 1 == input_dialog.focus_index);
+  }
+}
+
+static void move_input_focus(unsigned char i)
+{
+  unsigned char old_i = input_dialog.focus_index;
+  input_dialog.focus_index = i;
+  draw_input_widget(old_i);
+  if(old_i < input_dialog.input_count || i < input_dialog.input_count) draw_input_widget(i);
+}
+
 char input_dialog_loop(void)
 {
   char is_exit = 0;
@@ -333,41 +426,30 @@ char input_dialog_loop(void)
         size_t len = strlen(input->text);
         if(len > 0) {
           input->text[len - 1] = 0;
-          input_dialog_draw();
+          draw_input_widget(i);
         }
       }
       break;
     case CH_CURS_UP:
       if(i > 0) {
         if(i < input_dialog.input_count + 1)
-          input_dialog.focus_index--;
+          move_input_focus(i - 1);
         else
-          input_dialog.focus_index -= 2;
-        input_dialog_draw();
+          move_input_focus(i - 2);
       }
       break;
     case CH_CURS_DOWN:
-      if(i < input_dialog.input_count) {
-        input_dialog.focus_index++;
-        input_dialog_draw();
-      }
+      if(i < input_dialog.input_count) move_input_focus(i + 1);
       break;
     case CH_CURS_LEFT:
-      if(i == input_dialog.input_count + 1) {
-        input_dialog.focus_index--;
-        input_dialog_draw();
-      }
+      if(i == input_dialog.input_count + 1) move_input_focus(i - 1);
       break;
     case CH_CURS_RIGHT:
-      if(i == input_dialog.input_count) {
-        input_dialog.focus_index++;
-        input_dialog_draw();
-      }
+      if(i == input_dialog.input_count) move_input_focus(i + 1);
       break;
     case '\n':
       if(i < input_dialog.input_count) {
-        input_dialog.focus_index++;
-        input_dialog_draw();
+        move_input_focus(i + 1);
       } else {
         is_exit = 1;
         is_ok = (i == input_dialog.input_count);
@@ -386,7 +468,7 @@ char input_dialog_loop(void)
           if(len < input_dialog.inputs[i].max_text_len) {
             input->text[len] = c;
             input->text[len + 1] = 0;
-            input_dialog_draw();
+            draw_input_widget(i);
           }
         } else {
           if(c == ' ') {
@@ -398,6 +480,7 @@ char input_dialog_loop(void)
       break;
     }
   }
+  close_area(&(input_dialog.area));
   return is_ok;
 }
 
@@ -412,6 +495,7 @@ void progress_dialog_set(const char *title, const struct progress *progresses, u
   progress_dialog.title = title;
   progress_dialog.progresses = progresses;
   progress_dialog.progress_count = count;
+  progress_dialog.info = NULL;
   max_width = even(strlen(progress_dialog.title)) + 2;
   for(i = 0; i < progress_dialog.progress_count; i++) {
     const struct progress *progress = &(progress_dialog.progresses[i]);
@@ -431,22 +515,73 @@ void progress_dialog_draw(void)
   unsigned char i;
   unsigned char x = center_x(progress_dialog.width);
   unsigned char y = center_y(progress_dialog.height);
-  gotoxy(x, y);
+  open_area(&(progress_dialog.area), progress_dialog.width, progress_dialog.height);
+  screen_goto(x, y);
   draw_title(progress_dialog.title, progress_dialog.width);
   y++;
   for(i = 0; i < progress_dialog.progress_count; i++, y += 3) {
     const struct progress *progress = &(progress_dialog.progresses[i]);
-    gotoxy(x, y);
+    screen_goto(x, y);
     draw_empty(progress_dialog.width);
-    gotoxy(x , y + 1);
+    screen_goto(x , y + 1);
     draw_label(progress->label, progress_dialog.width);
-    gotoxy(x , y + 2);
+    screen_goto(x , y + 2);
     draw_progress(progress->count, progress->max, progress_dialog.width);    
   }
-  gotoxy(x, y);
+  if(progress_dialog.info != NULL) {
+    screen_goto(x, y);
+    draw_empty(progress_dialog.width);
+    y++;
+    screen_goto(x, y);
+    draw_label(progress_dialog.info, progress_dialog.width);
+    y++;
+  }
+  screen_goto(x, y);
   draw_empty(progress_dialog.width);
 }
 
+/*
+ * Sets the information line under the progresses. The information can be changed in place and can have
+ * at most the maximal length. It must be set before the progress dialog is drawn.
+ */
+void progress_dialog_set_info(const char *info, unsigned char max_len)
+{
+  progress_dialog.info = info;
+  progress_dialog.width = max(progress_dialog.width, even(max_len + 1) + 2);
+  progress_dialog.height += 2;
+}
+
+/*
+ * Draws only the cells of the progress bar that are changed from the old count.
+ */
+void progress_dialog_update(unsigned char i, unsigned old_count)
+{
+  const struct progress *progress = &(progress_dialog.progresses[i]);
+  unsigned char x = progress_dialog.area.x + 1;
+  unsigned char y = progress_dialog.area.y + 1 + i * 3 + 2;
+  if(progress->count > old_count) {
+    screen_goto(x + old_count, y);
+    screen_revers(1);
+    screen_fill(' ', progress->count - old_count);
+    screen_revers(0);
+  } else if(progress->count < old_count) {
+    screen_goto(x + progress->count, y);
+    screen_fill(' ', old_count - progress->count);
+  }
+}
+
+void progress_dialog_draw_info(void)
+{
+  unsigned char y = progress_dialog.area.y + 1 + progress_dialog.progress_count * 3 + 1;
+  screen_goto(progress_dialog.area.x, y);
+  draw_label(progress_dialog.info, progress_dialog.width);
+}
+
+
+
+void progress_dialog_close(void)
+{ close_area(&(progress_dialog.area)); }
+
 /*
  * A message dialog.
  */
@@ -468,22 +603,23 @@ void message_dialog_draw(void)
 {
   unsigned char x = center_x(message_dialog.width);
   unsigned char y = center_y(message_dialog.height);
-  gotoxy(x, y);
+  open_area(&(message_dialog.area), message_dialog.width, message_dialog.height);
+  screen_goto(x, y);
   draw_title(message_dialog.title, message_dialog.width);
   y++;
-  gotoxy(x, y);
+  screen_goto(x, y);
   draw_empty(message_dialog.width);
   y++;
-  gotoxy(x, y);
+  screen_goto(x, y);
   draw_message(message_dialog.message, message_dialog.width);
   y++;
-  gotoxy(x, y);
+  screen_goto(x, y);
   draw_empty(message_dialog.width);
   y++;  
-  gotoxy(x, y);
+  screen_goto(x, y);
   draw_one_button("OK", message_dialog.width, 1);
   y++;
-  gotoxy(x, y);
+  screen_goto(x, y);
   draw_empty(message_dialog.width);
 }
 
@@ -500,6 +636,7 @@ void message_dialog_loop(void)
       break;
     }
   }
+  close_area(&(message_dialog.area));
 }
 
 /*
@@ -524,27 +661,34 @@ void yes_no_dialog_draw(void)
   unsigned char x = center_x(yes_no_dialog.width);
   unsigned char y = center_y(yes_no_dialog.height);
   char is_focused1, is_focused2;
-  gotoxy(x, y);
+  open_area(&(yes_no_dialog.area), yes_no_dialog.width, yes_no_dialog.height);
+  screen_goto(x, y);
   draw_title(yes_no_dialog.title, yes_no_dialog.width);
   y++;
-  gotoxy(x, y);
+  screen_goto(x, y);
   draw_empty(yes_no_dialog.width);
   y++;
-  gotoxy(x, y);
+  screen_goto(x, y);
   draw_message(yes_no_dialog.message, yes_no_dialog.width);
   y++;
-  gotoxy(x, y);
+  screen_goto(x, y);
   draw_empty(yes_no_dialog.width);
   y++;  
-  gotoxy(x, y);
+  screen_goto(x, y);
   is_focused1 = (0 == yes_no_dialog.focus_index);
   is_focused2 = (1 == yes_no_dialog.focus_index);
   draw_two_buttons("Yes", "no", yes_no_dialog.width, is_focused1, is_focused2);
   y++;
-  gotoxy(x, y);
+  screen_goto(x, y);
   draw_empty(yes_no_dialog.width);
 }
 
+static void draw_yes_no_buttons(void)
+{
+  screen_goto(yes_no_dialog.area.x, yes_no_dialog.area.y + 4);
+  draw_two_buttons("Yes", "no", yes_no_dialog.width, yes_no_dialog.focus_index == 0, yes_no_dialog.focus_index == 1);
+}
+
 char yes_no_dialog_loop(void)
 {
   char is_exit = 0;
@@ -555,13 +699,13 @@ char yes_no_dialog_loop(void)
     case CH_CURS_LEFT:
       if(i == 1) {
         yes_no_dialog.focus_index--;
-        yes_no_dialog_draw();
+        draw_yes_no_buttons();
       }
       break;
     case CH_CURS_RIGHT:
       if(i == 0) {
         yes_no_dialog.focus_index++;
-        yes_no_dialog_draw();
+        draw_yes_no_buttons();
       }
       break;
     case '\n':
@@ -576,9 +720,178 @@ char yes_no_dialog_loop(void)
       break;
     }
   }
+  close_area(&(yes_no_dialog.area));
   return is_yes;
 }
 
+/*
+ * A help dialog.
+ */
+
+void help_dialog_set(const char *title, const char **labels, unsigned char count)
+{
+  unsigned char max_width;
+  unsigned char i;
+  help_dialog.title = title;
+  help_dialog.labels = labels;
+  help_dialog.label_count = count;
+  help_dialog.focus_index = 0;
+  max_width = even(strlen(help_dialog.title)) + 2;
+  for(i = 0; i < help_dialog.label_count; i++) {
+    max_width = max(max_width, even(strlen(help_dialog.labels[i])) + 2);
+  }
+  max_width = max(max_width, 6 + 2);
+  help_dialog.width = max_width;
+  help_dialog.height = help_dialog.label_count + 3 + 2;
+}
+
+void help_dialog_draw(void)
+{
+  unsigned char i;
+  unsigned char x = center_x(help_dialog.width);
+  unsigned char y = center_y(help_dialog.height);
+  open_area(&(help_dialog.area), help_dialog.width, help_dialog.height);
+  screen_goto(x, y);
+  draw_title(help_dialog.title, help_dialog.width);
+  y++;
+  screen_goto(x, y);
+  draw_empty(help_dialog.width);
+  y++;
+  for(i = 0; i < help_dialog.label_count; i++, y++) {
+    screen_goto(x, y);
+    draw_label(help_dialog.labels[i], help_dialog.width);
+  }
+  screen_goto(x, y);
+  draw_empty(help_dialog.width);
+  y++;
+  screen_goto(x, y);
+  draw_one_button("OK", help_dialog.width, 1);
+  y++;
+  screen_goto(x, y);
+  draw_empty(help_dialog.width);
+}
+
+void help_dialog_loop(void)
+{
+  char is_exit = 0;
+  while(!is_exit) {
+    switch(cgetc()) {
+    case '\n':
+    case ' ':
+    case CH_STOP:
+    case CH_ESC:
+      is_exit = 1;
+      break;
+    }
+  }
+  close_area(&(help_dialog.area));
+}
+
+/*
+ * A list dialog. The list is scrolled when the cursor leaves the view of the list.
+ */
+
+void list_dialog_set(const char *title, const char **labels, unsigned count)
+{
+  unsigned char max_width;
+  unsigned i;
+  list_dialog.title = title;
+  list_dialog.labels = labels;
+  list_dialog.label_count = count;
+  list_dialog.view_y = 0;
+  list_dialog.cursor_y = 0;
+  max_width = even(strlen(list_dialog.title)) + 2;
+  for(i = 0; i < list_dialog.label_count; i++) {
+    max_width = max(max_width, even(strlen(list_dialog.labels[i])) + 2);
+  }
+  list_dialog.width = max_width;
+  list_dialog.height = umin(list_dialog.label_count, LIST_DIALOG_VIEW_HEIGHT) + 3;
+}
+
+static void draw_list_row(unsigned char i)
+{
+  unsigned j = list_dialog.view_y + i;
+  screen_goto(list_dialog.area.x, list_dialog.area.y + 2 + i);
+  if(j == list_dialog.cursor_y) {
+    screen_revers(1);
+    screen_color(SCREEN_COLOR_CURSOR);
+    screen_putc(' ');
+    screen_revers(0);
+    screen_color(SCREEN_COLOR_FOREGROUND);
+    screen_puts(list_dialog.labels[j]);
+    screen_fill(' ', list_dialog.width - 2 - strlen(list_dialog.labels[j]));
+    screen_revers(1);
+    screen_color(SCREEN_COLOR_CURSOR);
+    screen_putc(' ');
+    screen_revers(0);
+    screen_color(SCREEN_COLOR_FOREGROUND);
+  } else
+    draw_label(list_dialog.labels[j], list_dialog.width);
+}
+
+static void draw_list_rows(void)
+{
+  unsigned char i;
+  for(i = 0; i < list_dialog.height - 3; i++) draw_list_row(i);
+}
+
+void list_dialog_draw(void)
+{
+  unsigned char x = center_x(list_dialog.width);
+  unsigned char y = center_y(list_dialog.height);
+  open_area(&(list_dialog.area), list_dialog.width, list_dialog.height);
+  screen_goto(x, y);
+  draw_title(list_dialog.title, list_dialog.width);
+  y++;
+  screen_goto(x, y);
+  draw_empty(list_dialog.width);
+  draw_list_rows();
+  screen_goto(x, y + list_dialog.height - 2);
+  draw_empty(list_dialog.width);
+}
+
+/*
+ * Returns the index of the chosen label or -1.
+ */
+int list_dialog_loop(void)
+{
+  int res = -2;
+  unsigned old_cursor_y;
+  while(res == -2) {
+    old_cursor_y = list_dialog.cursor_y;
+    switch(cgetc()) {
+    case CH_CURS_UP:
+      if(list_dialog.cursor_y > 0) list_dialog.cursor_y--;
+      break;
+    case CH_CURS_DOWN:
+      if(list_dialog.cursor_y + 1 < list_dialog.label_count) list_dialog.cursor_y++;
+      break;
+    case '\n':
+    case ' ':
+      res = list_dialog.cursor_y;
+      break;
+    case CH_STOP:
+    case CH_ESC:
+      res = -1;
+      break;
+    }
+    if(list_dialog.cursor_y != old_cursor_y) {
+      if(list_dialog.cursor_y < list_dialog.view_y) {
+        list_dialog.view_y = list_dialog.cursor_y;
+        draw_list_rows();
+      } else if(list_dialog.cursor_y >= list_dialog.view_y + LIST_DIALOG_VIEW_HEIGHT) {
+        list_dialog.view_y = list_dialog.cursor_y - LIST_DIALOG_VIEW_HEIGHT + 1;
+        draw_list_rows();
+      } else {
+        draw_list_row(old_cursor_y - list_dialog.view_y);
+        draw_list_row(list_dialog.cursor_y - list_dialog.view_y);
+      }
+    }
+  }
+  close_area(&(list_dialog.area));
+  return res;
+}
+
 /*
  * An about dialog.
  */
@@ -608,23 +921,24 @@ void about_dialog_draw(void)
   unsigned char i;
   unsigned char x = center_x(about_dialog.width);
   unsigned char y = center_y(about_dialog.height);
-  gotoxy(x, y);
+  open_area(&(about_dialog.area), about_dialog.width, about_dialog.height);
+  screen_goto(x, y);
   draw_title(about_dialog.title, about_dialog.width);
   y++;
-  gotoxy(x, y);
+  screen_goto(x, y);
   draw_empty(about_dialog.width);
   y++;
   for(i = 0; i < ABOUT_DIALOG_LABEL_COUNT; i++, y++) {
-    gotoxy(x, y);
+    screen_goto(x, y);
     draw_label(about_dialog.labels[i], about_dialog.width);
   }
-  gotoxy(x, y);
+  screen_goto(x, y);
   draw_empty(about_dialog.width);
   y++;
-  gotoxy(x, y);
+  screen_goto(x, y);
   draw_one_button("OK", about_dialog.width, 1);
   y++;
-  gotoxy(x, y);
+  screen_goto(x, y);
   draw_empty(about_dialog.width);
 }
 
@@ -641,4 +955,5 @@ void about_dialog_loop(void)
       break;
     }
   }
+  close_area(&(about_dialog.area));
 }
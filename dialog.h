@@ -41,6 +41,10 @@ struct progress
 
 void progress_dialog_set(const char *title, const struct progress *progresses, unsigned char count);
 void progress_dialog_draw(void);
+void progress_dialog_set_info(const char *info, unsigned char max_len);
+void progress_dialog_update(unsigned char i, unsigned old_count);
+void progress_dialog_draw_info(void);
+void progress_dialog_close(void);
 
 void message_dialog_set(const char *title, const char *msg);
 void message_dialog_draw(void);
@@ -50,6 +54,14 @@ void yes_no_dialog_set(const char *title, const char *msg);
 void yes_no_dialog_draw(void);
 char yes_no_dialog_loop(void);
 
+void help_dialog_set(const char *title, const char **labels, unsigned char count);
+void help_dialog_draw(void);
+void help_dialog_loop(void);
+
+void list_dialog_set(const char *title, const char **labels, unsigned count);
+void list_dialog_draw(void);
+int list_dialog_loop(void);
+
 void about_dialog_set(void);
 void about_dialog_draw(void);
 void about_dialog_loop(void);
@@ -16,13 +16,13 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include <cbm.h>
-#include <conio.h>
 #include <errno.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include "cmd_channel.h"
 #include "dir_panel.h"
+#include "job.h"
 #include "screen.h"
 #include "util.h"
 
@@ -39,12 +39,17 @@ void initialize_dir_panels(void)
     dir_panel->status = DIR_PANEL_STATUS_UNLOADED;
     dir_panel->has_header_dir_entry = 0;
     dir_panel->has_tail_dir_entry = 0;
-    dir_panel->dir_list = NULL;
+    arena_init(&(dir_panel->arena), sizeof(struct dir_list_elem) * DIR_LIST_CHUNK_LENGTH * 2);
     dir_panel->dir_list_length = 0;
+    dir_panel->dir_list_capacity = 0;
+    dir_panel->loaded_dir_list_length = 0;
+    dir_panel->lfn = 0;
     dir_panel->view_y = 0;
     dir_panel->cursor_y = 0;
     dir_panel->selected_elem_indices = NULL;
     dir_panel->selected_elem_index_count = 0;
+    dir_panel->sorted_elem_indices = NULL;
+    dir_panel->has_selection_pattern = 0;
   }
   current_dir_panel = &dir_panels[0];
 }
@@ -53,128 +58,101 @@ void finalize_dir_panels(void)
 {
   unsigned char i;
   for(i = 0; i < DIR_PANEL_MAX; i++) {
-    struct dir_panel *dir_panel = &dir_panels[i];
-    if(dir_panel->dir_list != NULL)
-      free(dir_panel->dir_list);
-    if(dir_panel->selected_elem_indices != NULL)
-      free(dir_panel->selected_elem_indices);
+    arena_free(&(dir_panels[i].arena));
   }
 }
 
 static void draw_header_dir_entry(struct dir_panel *dir_panel)
 {
-  cputc(0xb0);
+  screen_putc(0xb0);
   if(dir_panel->has_header_dir_entry) {
-    unsigned char i, len;
-    cprintf("Dev%02d", (unsigned) (dir_panel->device));
-    cputc(0x60);
-    safely_cputs(dir_panel->header_dir_entry.name);
+    unsigned char len;
+    screen_puts("Dev");
+    screen_put_uint(dir_panel->device, 2, '0');
+    screen_putc(0x60);
+    screen_puts(dir_panel->header_dir_entry.name);
     len = strlen(dir_panel->header_dir_entry.name);
-    for(i = 0; i < 16 - len; i++) {
-      cputc(0x60);
-    }
-    for(i = 0; i < 4; i++) {
-      cputc(0x60);
-    }
-  } else {
-    size_t i;
-    for(i = 0; i < DIR_PANEL_WIDTH - 2; i++) {
-      cputc(0x60);
-    }
-  }
-  cputc(0xae);
+    screen_fill(0x60, 16 - len + 4);
+  } else
+    screen_fill(0x60, DIR_PANEL_WIDTH - 2);
+  screen_putc(0xae);
 }
 
 static void draw_tail_dir_entry(struct dir_panel *dir_panel)
 {
-  cputc(0xad);
+  screen_putc(0xad);
   if(dir_panel->has_tail_dir_entry) {
-    unsigned char i;
-    cprintf("%5u ", dir_panel->tail_dir_entry.size);
-    cputs("blocks free");
-    for(i = 0; i < 16 - 11; i++) {
-      cputc(0x60);
-    }
-    for(i = 0; i < 4; i++) {
-      cputc(0x60);
-    }
-  } else {
-    size_t i;
-    for(i = 0; i < DIR_PANEL_WIDTH - 2; i++) {
-      cputc(0x60);
-    }
-  }
-  cputc(0xbd);
+    screen_put_uint(dir_panel->tail_dir_entry.size, 5, ' ');
+    screen_puts(" blocks free");
+    screen_fill(0x60, 16 - 11 + 4);
+  } else
+    screen_fill(0x60, DIR_PANEL_WIDTH - 2);
+  screen_putc(0xbd);
 }
 
-static void draw_dir_list_elem(struct dir_panel *dir_panel, unsigned y)
+static const char *file_type_to_str(unsigned char file_type)
 {
-  struct dir_list_elem *elem = &(dir_panel->dir_list[y]);
-  unsigned char i, len;
-  cputc(0xdd);
-  revers(elem->is_selected ^ (y == dir_panel->cursor_y));
-  if((y == dir_panel->cursor_y)) textcolor(SCREEN_COLOR_CURSOR);
-  cprintf("%5u", elem->entry.size);
-  cputc(' ');
-  safely_cputs(elem->entry.name);
-  len = strlen(elem->entry.name);
-  for(i = 0; i < 16 - len; i++) {
-    cputc(' ');
-  }
-  cputc(' ');
-  switch(elem->entry.type) {
+  switch(file_type) {
   case _CBM_T_SEQ:
-    cputs("seq");
-    break;
+    return "seq";
   case _CBM_T_PRG:
-    cputs("prg");
-    break;
+    return "prg";
   case _CBM_T_USR:
-    cputs("usr");
-    break;
+    return "usr";
   case _CBM_T_REL:
-    cputs("rel");
-    break;
+    return "rel";
   case _CBM_T_VRP:
-    cputs("vrp");
-    break;
+    return "vrp";
   case _CBM_T_DEL:
-    cputs("del");
-    break;
+    return "del";
   case _CBM_T_CBM:
-    cputs("cbm");
-    break;
+    return "cbm";
   case _CBM_T_DIR:
-    cputs("dir");
-    break;
+    return "dir";
   case _CBM_T_LNK:
-    cputs("lnk");
-    break;
+    return "lnk";
   default:
-    cputs("oth");
-    break;
+    return "oth";
   }
-  revers(0);
-  if((y == dir_panel->cursor_y)) textcolor(SCREEN_COLOR_FOREGROUND);
-  cputc(0xdd); 
+}
+
+/*
+ * Formats the element of directory list to its row in screen codes when the element is loaded, so
+ * drawing of the element only copies this row.
+ */
+static void format_dir_list_elem(struct dir_list_elem *elem)
+{
+  unsigned char *buf = elem->row;
+  buf = screen_format_uint(buf, elem->entry.size, 5, ' ');
+  buf = screen_format_fill(buf, ' ', 1);
+  buf = screen_format_str(buf, elem->entry.name);
+  buf = screen_format_fill(buf, ' ', 16 - strlen(elem->entry.name) + 1);
+  screen_format_str(buf, file_type_to_str(elem->entry.type));
+}
+
+static void draw_dir_list_elem(struct dir_panel *dir_panel, unsigned y)
+{
+  struct dir_list_elem *elem = dir_panel_elem(dir_panel, y);
+  screen_putc(0xdd);
+  screen_revers(elem->is_selected ^ (y == dir_panel->cursor_y));
+  if((y == dir_panel->cursor_y)) screen_color(SCREEN_COLOR_CURSOR);
+  screen_put_codes(elem->row, DIR_PANEL_VIEW_WIDTH);
+  screen_revers(0);
+  if((y == dir_panel->cursor_y)) screen_color(SCREEN_COLOR_FOREGROUND);
+  screen_putc(0xdd); 
 }
 
 static void draw_empty(void)
 {
-  unsigned char i;
-  cputc(0xdd);
-  for(i = 0; i < DIR_PANEL_VIEW_WIDTH; i++) {
-    cputc(' ');
-  }
-  cputc(0xdd);
+  screen_putc(0xdd);
+  screen_fill(' ', DIR_PANEL_VIEW_WIDTH);
+  screen_putc(0xdd);
 }
 
 void dir_panel_draw(struct dir_panel *dir_panel)
 {
-  const char *msg = NULL;
-  size_t i, len;
   unsigned char screen_x = center_x(DIR_PANEL_WIDTH);
-  gotoxy(center_x(DIR_PANEL_WIDTH), 0);
+  screen_goto(center_x(DIR_PANEL_WIDTH), 0);
   draw_header_dir_entry(dir_panel);
   if(dir_panel->status == DIR_PANEL_STATUS_LOADED) {
     unsigned char screen_y;
@@ -184,197 +162,319 @@ void dir_panel_draw(struct dir_panel *dir_panel)
     else
       max_y = dir_panel->dir_list_length;
     for(screen_y = 1, y = dir_panel->view_y; y < max_y; y++, screen_y++) {
-      gotoxy(screen_x, screen_y);
+      screen_goto(screen_x, screen_y);
       draw_dir_list_elem(dir_panel, y);
     }
     for(; y < dir_panel->view_y + DIR_PANEL_VIEW_HEIGHT; y++, screen_y++) {
-      gotoxy(screen_x, screen_y);
+      screen_goto(screen_x, screen_y);
       draw_empty();
     }
   } else {
     unsigned char screen_y;
     size_t y;
     for(screen_y = 1, y = 0; y < DIR_PANEL_VIEW_HEIGHT; y++, screen_y++) {
-      gotoxy(screen_x, screen_y);
+      screen_goto(screen_x, screen_y);
       draw_empty();
     }
   }
-  gotoxy(screen_x, DIR_PANEL_HEIGHT - 2);
+  screen_goto(screen_x, DIR_PANEL_HEIGHT - 2);
   draw_tail_dir_entry(dir_panel);
+  dir_panel_draw_status(dir_panel);
+}
+
+/*
+ * Draws the status line of the directory panel. The status of the running job is drawn if the directory
+ * panel hasn't any message.
+ */
+void dir_panel_draw_status(struct dir_panel *dir_panel)
+{
+  const char *msg = NULL;
+  size_t len;
   if(dir_panel->status == DIR_PANEL_STATUS_LOADING) 
     msg = "Loading directory ...";
   else if(dir_panel->status == DIR_PANEL_STATUS_ERROR)
     msg = dir_panel->error;
-  gotoxy(0, DIR_PANEL_HEIGHT - 1);
-  for(i = 0; i < screen_width; i++) {
-    cputc(' ');
-  }
+  else
+    msg = job_status();
+  screen_goto(0, DIR_PANEL_HEIGHT - 1);
+  screen_fill(' ', screen_width);
   if(msg != NULL) {
     len = strlen(msg);
-    gotoxy(center_x(len), DIR_PANEL_HEIGHT - 1);
-    safely_cputs(msg);
+    screen_goto(center_x(len), DIR_PANEL_HEIGHT - 1);
+    screen_puts(msg);
   }
 }
 
-void dir_panel_reload(struct dir_panel *dir_panel)
+/*
+ * Frees the directory list with its indices by releasing the arena of the panel in one step.
+ */
+static void free_dir_list(struct dir_panel *dir_panel)
 {
-  static struct cbm_dirent entry;
-  unsigned char lfn = 14;
-  unsigned char res;
-  int res2;
-  const char *error;
-  size_t i, capacity;
-  if(dir_panel->dir_list != NULL) {
-    free(dir_panel->dir_list);
-    dir_panel->dir_list = NULL;
-  }
-  if(dir_panel->selected_elem_indices != NULL) {
-    free(dir_panel->selected_elem_indices);
-    dir_panel->selected_elem_indices = NULL;
-  }
-  dir_panel->status = DIR_PANEL_STATUS_LOADING;
+  arena_free(&(dir_panel->arena));
+  dir_panel->dir_list_capacity = 0;
+  dir_panel->selected_elem_indices = NULL;
+  dir_panel->sorted_elem_indices = NULL;
   dir_panel->has_header_dir_entry = 0;
   dir_panel->has_tail_dir_entry = 0;
   dir_panel->dir_list_length = 0;
   dir_panel->selected_elem_index_count = 0;
-  dir_panel_draw(dir_panel);
+  dir_panel->has_selection_pattern = 0;
+}
+
+static void set_status_to_error(struct dir_panel *dir_panel)
+{
+  dir_panel->status = DIR_PANEL_STATUS_ERROR;
+  dir_panel->has_header_dir_entry = 0;
+  dir_panel->has_tail_dir_entry = 0;
+  dir_panel->view_y = 0;
+  dir_panel->cursor_y = 0;
+}
+
+/*
+ * Starts loading of the directory. The directory is loaded by the dir_panel_load_next function. The
+ * directory list isn't visible until the directory is loaded. Returns zero if an error occurred,
+ * otherwise non-zero.
+ */
+char dir_panel_start_loading(struct dir_panel *dir_panel, unsigned char lfn)
+{
+  unsigned char res;
+  int res2;
+  const char *error;
+  free_dir_list(dir_panel);
+  dir_panel->status = DIR_PANEL_STATUS_LOADING;
+  dir_panel->lfn = lfn;
   res = cbm_opendir(lfn, dir_panel->device, "$");
   if(res != 0) {
     dir_panel->error = _stroserror(_oserror);
     cbm_closedir(lfn);
-    dir_panel->status = DIR_PANEL_STATUS_ERROR;
-    dir_panel->has_header_dir_entry = 0;
-    dir_panel->has_tail_dir_entry = 0;
-    dir_panel->view_y = 0;
-    dir_panel->cursor_y = 0;
-    dir_panel_draw(dir_panel);
-    return;
+    set_status_to_error(dir_panel);
+    return 0;
   }
   res2 = cmd_channel_read(dir_panel->device, &error, 1);
   if(res2 == -1) {
     dir_panel->error = _stroserror(_oserror);
     cbm_closedir(lfn);
-    dir_panel->status = DIR_PANEL_STATUS_ERROR;
-    dir_panel->has_header_dir_entry = 0;
-    dir_panel->has_tail_dir_entry = 0;
-    dir_panel->view_y = 0;
-    dir_panel->cursor_y = 0;
-    dir_panel_draw(dir_panel);
-    return;    
+    set_status_to_error(dir_panel);
+    return 0;
   } else if(res2 > 0) {
     strcpy(dir_panel->error_buffer, error);
     dir_panel->error = dir_panel->error_buffer;
     cbm_closedir(lfn);
     cmd_channel_close(dir_panel->device);
-    dir_panel->status = DIR_PANEL_STATUS_ERROR;
-    dir_panel->has_header_dir_entry = 0;
-    dir_panel->has_tail_dir_entry = 0;
-    dir_panel->view_y = 0;
-    dir_panel->cursor_y = 0;
-    dir_panel_draw(dir_panel);
-    return;
+    set_status_to_error(dir_panel);
+    return 0;
   }
-  capacity = 8;
-  dir_panel->dir_list = malloc(sizeof(struct dir_list_elem) * capacity);
-  if(dir_panel->dir_list == NULL) {
-    dir_panel->error = "Out of memory";
-    cbm_closedir(lfn);
+  dir_panel->loaded_dir_list_length = 0;
+  return 1;
+}
+
+static void stop_loading_with_error(struct dir_panel *dir_panel, const char *error)
+{
+  dir_panel->error = error;
+  cbm_closedir(dir_panel->lfn);
+  cmd_channel_close(dir_panel->device);
+  free_dir_list(dir_panel);
+  set_status_to_error(dir_panel);
+}
+
+/*
+ * Loads the next directory entry. Returns zero if the directory is loaded or an error occurred,
+ * otherwise non-zero.
+ */
+char dir_panel_load_next(struct dir_panel *dir_panel)
+{
+  static struct cbm_dirent entry;
+  unsigned char res;
+  res = cbm_readdir(dir_panel->lfn, &entry);
+  if(res == 0) {
+    if(entry.type == _CBM_T_HEADER) {
+      dir_panel->has_header_dir_entry = 1;
+      dir_panel->header_dir_entry = entry;
+    } else {
+      unsigned i = dir_panel->loaded_dir_list_length;
+      struct dir_list_elem *elem;
+      if(i >= dir_panel->dir_list_capacity) {
+        struct dir_list_elem *chunk;
+        if(i >= DIR_LIST_CHUNK_LENGTH * DIR_LIST_CHUNK_MAX) {
+          stop_loading_with_error(dir_panel, "Too many files");
+          return 0;
+        }
+        chunk = arena_alloc(&(dir_panel->arena), sizeof(struct dir_list_elem) * DIR_LIST_CHUNK_LENGTH);
+        if(chunk == NULL) {
+          stop_loading_with_error(dir_panel, "Out of memory");
+          return 0;
+        }
+        dir_panel->dir_list_chunks[i / DIR_LIST_CHUNK_LENGTH] = chunk;
+        dir_panel->dir_list_capacity += DIR_LIST_CHUNK_LENGTH;
+      }
+      elem = dir_panel_elem(dir_panel, i);
+      elem->is_selected = 0;
+      elem->entry = entry;
+      format_dir_list_elem(elem);
+      dir_panel->loaded_dir_list_length++;
+    }
+  } else if(res == 2) {
+    dir_panel->has_tail_dir_entry = 1;
+    dir_panel->tail_dir_entry = entry;
+  } else {
+    dir_panel->dir_list_length = dir_panel->loaded_dir_list_length;
+    cbm_close(dir_panel->lfn);
     cmd_channel_close(dir_panel->device);
-    dir_panel->status = DIR_PANEL_STATUS_ERROR;
-    dir_panel->has_header_dir_entry = 0;
-    dir_panel->has_tail_dir_entry = 0;
+    dir_panel->status = DIR_PANEL_STATUS_LOADED;
     dir_panel->view_y = 0;
     dir_panel->cursor_y = 0;
-    dir_panel_draw(dir_panel);
-    return;
+    return 0;
   }
-  dir_panel->has_header_dir_entry = 0;
-  dir_panel->has_tail_dir_entry = 0;
-  i = 0;
-  while(1) {
-    res = cbm_readdir(lfn, &entry);
-    if(res == 0) {
-      if(entry.type == _CBM_T_HEADER) {
-        dir_panel->has_header_dir_entry = 1;
-        dir_panel->header_dir_entry = entry;
-      } else {
-        if(i >= capacity) {
-          struct dir_list_elem *old_dir_list = dir_panel->dir_list;
-          capacity += 8;
-          dir_panel->dir_list = realloc(old_dir_list, sizeof(struct dir_list_elem) * capacity);
-          if(dir_panel->dir_list == NULL) {
-            dir_panel->error = "Out of memory";
-            free(old_dir_list);
-            cbm_closedir(lfn);
-            cmd_channel_close(dir_panel->device);
-            dir_panel->status = DIR_PANEL_STATUS_ERROR;
-            dir_panel->has_header_dir_entry = 0;
-            dir_panel->has_tail_dir_entry = 0;
-            dir_panel->view_y = 0;
-            dir_panel->cursor_y = 0;
-            dir_panel_draw(dir_panel);
-            return;
-          }
-        }
-        dir_panel->dir_list[i].is_selected = 0;
-        dir_panel->dir_list[i].entry = entry;
-        i++;
-      }
-    } else if(res == 2) {
-      dir_panel->has_tail_dir_entry = 1;
-      dir_panel->tail_dir_entry = entry;
-    } else
-      break;
-  }
-  dir_panel->dir_list_length = i;
-  cbm_close(lfn);
+  return 1;
+}
+
+void dir_panel_stop_loading(struct dir_panel *dir_panel)
+{
+  if(dir_panel->status != DIR_PANEL_STATUS_LOADING) return;
+  cbm_closedir(dir_panel->lfn);
   cmd_channel_close(dir_panel->device);
-  dir_panel->status = DIR_PANEL_STATUS_LOADED;
-  dir_panel->view_y = 0;
-  dir_panel->cursor_y = 0;
+  dir_panel_set_status_to_unloaded(dir_panel);
+}
+
+void dir_panel_reload(struct dir_panel *dir_panel)
+{
+  char is_loading;
+  free_dir_list(dir_panel);
+  dir_panel->status = DIR_PANEL_STATUS_LOADING;
+  dir_panel_draw(dir_panel);
+  is_loading = dir_panel_start_loading(dir_panel, 14);
+  while(is_loading) {
+    is_loading = dir_panel_load_next(dir_panel);
+  }
   dir_panel_draw(dir_panel);
 }
 
 char dir_panel_is_loaded(struct dir_panel *dir_panel)
 { return dir_panel->status == DIR_PANEL_STATUS_LOADED || dir_panel->status == DIR_PANEL_STATUS_ERROR; }
 
-void dir_panel_move_cursor_up(struct dir_panel *dir_panel)
+/*
+ * Draws only the element in the view. It is used instead of dir_panel_draw if at most two elements
+ * are changed.
+ */
+static void draw_dir_list_elem_in_view(struct dir_panel *dir_panel, unsigned y)
 {
-  if(dir_panel->cursor_y > 0) {
-    dir_panel->cursor_y--;
-    if(dir_panel->cursor_y < dir_panel->view_y) dir_panel->view_y--;
+  if(y < dir_panel->view_y || y >= dir_panel->view_y + DIR_PANEL_VIEW_HEIGHT) return;
+  screen_goto(center_x(DIR_PANEL_WIDTH), 1 + (y - dir_panel->view_y));
+  draw_dir_list_elem(dir_panel, y);
+}
+
+/*
+ * Draws the directory panel after the cursor movement. If the view is shifted by at most one row, only
+ * the old cursor row and the new cursor row are drawn.
+ */
+static void draw_after_cursor_movement(struct dir_panel *dir_panel, unsigned old_cursor_y, unsigned old_view_y)
+{
+  if(dir_panel->view_y + 1 == old_view_y)
+    screen_scroll_down(center_x(DIR_PANEL_WIDTH) + 1, 1, DIR_PANEL_VIEW_WIDTH, DIR_PANEL_VIEW_HEIGHT);
+  else if(dir_panel->view_y == old_view_y + 1)
+    screen_scroll_up(center_x(DIR_PANEL_WIDTH) + 1, 1, DIR_PANEL_VIEW_WIDTH, DIR_PANEL_VIEW_HEIGHT);
+  else if(dir_panel->view_y != old_view_y) {
     dir_panel_draw(dir_panel);
+    return;
   }
+  draw_dir_list_elem_in_view(dir_panel, old_cursor_y);
+  draw_dir_list_elem_in_view(dir_panel, dir_panel->cursor_y);
 }
 
-void dir_panel_move_cursor_down(struct dir_panel *dir_panel)
+void dir_panel_move_cursor_up(struct dir_panel *dir_panel, unsigned count)
 {
+  unsigned old_cursor_y = dir_panel->cursor_y;
+  unsigned old_view_y = dir_panel->view_y;
+  if(dir_panel->cursor_y > 0) {
+    dir_panel->cursor_y -= umin(count, dir_panel->cursor_y);
+    if(dir_panel->cursor_y < dir_panel->view_y) dir_panel->view_y = dir_panel->cursor_y;
+    draw_after_cursor_movement(dir_panel, old_cursor_y, old_view_y);
+  }
+}
+
+void dir_panel_move_cursor_down(struct dir_panel *dir_panel, unsigned count)
+{
+  unsigned old_cursor_y = dir_panel->cursor_y;
+  unsigned old_view_y = dir_panel->view_y;
   if(dir_panel->dir_list_length == 0) return;
   if(dir_panel->cursor_y < dir_panel->dir_list_length - 1) {
-    dir_panel->cursor_y++;
-    if(dir_panel->cursor_y > dir_panel->view_y + DIR_PANEL_VIEW_HEIGHT - 1) dir_panel->view_y++;
-    dir_panel_draw(dir_panel);
+    dir_panel->cursor_y += umin(count, dir_panel->dir_list_length - 1 - dir_panel->cursor_y);
+    if(dir_panel->cursor_y > dir_panel->view_y + DIR_PANEL_VIEW_HEIGHT - 1)
+      dir_panel->view_y = dir_panel->cursor_y - (DIR_PANEL_VIEW_HEIGHT - 1);
+    draw_after_cursor_movement(dir_panel, old_cursor_y, old_view_y);
   }
 }
 
 void dir_panel_select_or_unselect(struct dir_panel *dir_panel)
 {
   if(dir_panel->dir_list_length == 0) return;
-  dir_panel->dir_list[dir_panel->cursor_y].is_selected ^= 1;
+  dir_panel_elem(dir_panel, dir_panel->cursor_y)->is_selected ^= 1;
+  dir_panel->has_selection_pattern = 0;
+  draw_dir_list_elem_in_view(dir_panel, dir_panel->cursor_y);
+}
+
+/*
+ * Selects or unselects elements that match the pattern and have the file type. The file type is -1 for
+ * any file type. If the elements are selected by the pattern and any other elements aren't selected,
+ * the pattern is remembered as selection pattern, so the selection can be passed to a device as one
+ * DOS command.
+ */
+void dir_panel_select_by_pattern(struct dir_panel *dir_panel, const char *pattern, int file_type, char is_selected)
+{
+  unsigned i;
+  char had_selected_elems = 0;
+  char has_matched_elems = 0;
+  for(i = 0; i < dir_panel->dir_list_length; i++) {
+    struct dir_list_elem *elem = dir_panel_elem(dir_panel, i);
+    if(elem->is_selected) had_selected_elems = 1;
+    if((file_type == -1 || elem->entry.type == file_type) && match_pattern(pattern, elem->entry.name)) {
+      elem->is_selected = is_selected;
+      has_matched_elems = 1;
+    }
+  }
+  if(is_selected && file_type == -1 && !had_selected_elems && has_matched_elems) {
+    dir_panel->has_selection_pattern = 1;
+    strcpy(dir_panel->selection_pattern, pattern);
+  } else
+    dir_panel->has_selection_pattern = 0;
+  dir_panel_draw(dir_panel);
+}
+
+void dir_panel_select_all(struct dir_panel *dir_panel)
+{
+  unsigned i;
+  for(i = 0; i < dir_panel->dir_list_length; i++) {
+    dir_panel_elem(dir_panel, i)->is_selected = 1;
+  }
+  dir_panel->has_selection_pattern = (dir_panel->dir_list_length > 0);
+  strcpy(dir_panel->selection_pattern, "*");
+  dir_panel_draw(dir_panel);
+}
+
+void dir_panel_invert_selection(struct dir_panel *dir_panel)
+{
+  unsigned i;
+  for(i = 0; i < dir_panel->dir_list_length; i++) {
+    dir_panel_elem(dir_panel, i)->is_selected ^= 1;
+  }
+  dir_panel->has_selection_pattern = 0;
   dir_panel_draw(dir_panel);
 }
 
+const char *dir_panel_selection_pattern(struct dir_panel *dir_panel)
+{ return dir_panel->has_selection_pattern ? dir_panel->selection_pattern : NULL; }
+
 unsigned *dir_panel_selected_elem_indices(struct dir_panel *dir_panel, unsigned *count)
 {
   unsigned i, j;
   if(dir_panel->selected_elem_indices == NULL) {
     size_t capacity = dir_panel->dir_list_length > 0 ? dir_panel->dir_list_length : 1;
-    dir_panel->selected_elem_indices = malloc(sizeof(int) * capacity);
+    dir_panel->selected_elem_indices = arena_alloc(&(dir_panel->arena), sizeof(unsigned) * capacity);
     if(dir_panel->selected_elem_indices == NULL) return NULL;
   }
   j = 0;
   for(i = 0; i < dir_panel->dir_list_length; i++) {
-    if(dir_panel->dir_list[i].is_selected) {
+    if(dir_panel_elem(dir_panel, i)->is_selected) {
       dir_panel->selected_elem_indices[j] = i;
       j++;
     }
@@ -389,19 +489,76 @@ unsigned *dir_panel_selected_elem_indices(struct dir_panel *dir_panel, unsigned
   return dir_panel->selected_elem_indices;
 }
 
-void dir_panel_set_status_to_unloaded(struct dir_panel *dir_panel)
+static struct dir_panel *dir_panel_to_sort;
+
+static int compare_elem_indices(const void *index1, const void *index2)
+{
+  const char *name1 = dir_panel_elem(dir_panel_to_sort, *((const unsigned *) index1))->entry.name;
+  const char *name2 = dir_panel_elem(dir_panel_to_sort, *((const unsigned *) index2))->entry.name;
+  return strcmp(name1, name2);
+}
+
+unsigned *dir_panel_sorted_elem_indices(struct dir_panel *dir_panel)
+{
+  unsigned i;
+  if(dir_panel->sorted_elem_indices == NULL) {
+    size_t capacity = dir_panel->dir_list_length > 0 ? dir_panel->dir_list_length : 1;
+    dir_panel->sorted_elem_indices = arena_alloc(&(dir_panel->arena), sizeof(unsigned) * capacity);
+    if(dir_panel->sorted_elem_indices == NULL) return NULL;
+    for(i = 0; i < dir_panel->dir_list_length; i++) {
+      dir_panel->sorted_elem_indices[i] = i;
+    }
+    dir_panel_to_sort = dir_panel;
+    qsort(dir_panel->sorted_elem_indices, dir_panel->dir_list_length, sizeof(unsigned), compare_elem_indices);
+  }
+  return dir_panel->sorted_elem_indices;
+}
+
+/*
+ * Finds the first element that matches the pattern at or after the *sorted_index position in the sorted
+ * index. The position of the pattern prefix is found by a binary search, so only elements with this
+ * prefix are matched. Returns 1 if the element is found, 0 if it isn't found or -1 if an error occurred.
+ */
+int dir_panel_find(struct dir_panel *dir_panel, const char *pattern, unsigned *sorted_index)
 {
-  if(dir_panel->dir_list != NULL) {
-    free(dir_panel->dir_list);
-    dir_panel->dir_list = NULL;
+  unsigned *sorted_elem_indices = dir_panel_sorted_elem_indices(dir_panel);
+  size_t prefix_len = strcspn(pattern, "*?");
+  unsigned low, high;
+  if(sorted_elem_indices == NULL) return -1;
+  low = 0;
+  high = dir_panel->dir_list_length;
+  while(low < high) {
+    unsigned middle = low + ((high - low) >> 1);
+    if(strncmp(dir_panel_elem(dir_panel, sorted_elem_indices[middle])->entry.name, pattern, prefix_len) < 0)
+      low = middle + 1;
+    else
+      high = middle;
   }
-  if(dir_panel->selected_elem_indices != NULL) {
-    free(dir_panel->selected_elem_indices);
-    dir_panel->selected_elem_indices = NULL;
+  if(low < *sorted_index) low = *sorted_index;
+  for(; low < dir_panel->dir_list_length; low++) {
+    const char *name = dir_panel_elem(dir_panel, sorted_elem_indices[low])->entry.name;
+    if(strncmp(name, pattern, prefix_len) != 0) break;
+    if(match_pattern(pattern, name)) {
+      *sorted_index = low;
+      return 1;
+    }
   }
+  return 0;
+}
+
+void dir_panel_set_cursor(struct dir_panel *dir_panel, unsigned y)
+{
+  if(y >= dir_panel->dir_list_length) return;
+  dir_panel->cursor_y = y;
+  if(y < dir_panel->view_y)
+    dir_panel->view_y = y;
+  else if(y > dir_panel->view_y + DIR_PANEL_VIEW_HEIGHT - 1)
+    dir_panel->view_y = y - (DIR_PANEL_VIEW_HEIGHT - 1);
+  dir_panel_draw(dir_panel);
+}
+
+void dir_panel_set_status_to_unloaded(struct dir_panel *dir_panel)
+{
+  free_dir_list(dir_panel);
   dir_panel->status = DIR_PANEL_STATUS_UNLOADED;
-  dir_panel->has_header_dir_entry = 0;
-  dir_panel->has_tail_dir_entry = 0;
-  dir_panel->dir_list_length = 0;
-  dir_panel->selected_elem_index_count = 0;
 }
@@ -19,6 +19,7 @@
 #define _DIR_PANEL_H
 
 #include <cbm.h>
+#include "arena.h"
 
 #define DIR_PANEL_WIDTH                 (16 + 2 + 5 + 3 + 2)
 #define DIR_PANEL_HEIGHT                (25 - 3)
@@ -27,6 +28,9 @@
 
 #define DIR_PANEL_MAX                   4
 
+#define DIR_LIST_CHUNK_LENGTH           16
+#define DIR_LIST_CHUNK_MAX              64
+
 #define DIR_PANEL_STATUS_UNLOADED       0
 #define DIR_PANEL_STATUS_LOADING        1
 #define DIR_PANEL_STATUS_LOADED         2
@@ -36,6 +40,7 @@ struct dir_list_elem
 {
   char is_selected;
   struct cbm_dirent entry;
+  unsigned char row[DIR_PANEL_VIEW_WIDTH];
 };
 
 struct dir_panel
@@ -47,15 +52,28 @@ struct dir_panel
   struct cbm_dirent header_dir_entry;
   char has_tail_dir_entry;
   struct cbm_dirent tail_dir_entry;
-  struct dir_list_elem *dir_list;
+  struct arena arena;
+  struct dir_list_elem *dir_list_chunks[DIR_LIST_CHUNK_MAX];
   unsigned dir_list_length;
+  unsigned dir_list_capacity;
+  unsigned loaded_dir_list_length;
+  unsigned char lfn;
   unsigned view_y;
   unsigned cursor_y;
   char error_buffer[39];
   unsigned *selected_elem_indices;
   unsigned selected_elem_index_count;
+  unsigned *sorted_elem_indices;
+  char has_selection_pattern;
+  char selection_pattern[17];
 };
 
+/*
+ * The directory list is stored in chunks of elements that are allocated from the arena of the
+ * panel, so the elements are never moved while the directory is loaded.
+ */
+#define dir_panel_elem(dir_panel, i)    (&((dir_panel)->dir_list_chunks[(i) / DIR_LIST_CHUNK_LENGTH][(i) % DIR_LIST_CHUNK_LENGTH]))
+
 extern struct dir_panel dir_panels[DIR_PANEL_MAX];
 
 extern struct dir_panel *current_dir_panel;
@@ -64,12 +82,23 @@ void initialize_dir_panels(void);
 void finalize_dir_panels(void);
 
 void dir_panel_draw(struct dir_panel *dir_panel);
+void dir_panel_draw_status(struct dir_panel *dir_panel);
+char dir_panel_start_loading(struct dir_panel *dir_panel, unsigned char lfn);
+char dir_panel_load_next(struct dir_panel *dir_panel);
+void dir_panel_stop_loading(struct dir_panel *dir_panel);
 void dir_panel_reload(struct dir_panel *dir_panel);
 char dir_panel_is_loaded(struct dir_panel *dir_panel);
-void dir_panel_move_cursor_up(struct dir_panel *dir_panel);
-void dir_panel_move_cursor_down(struct dir_panel *dir_panel);
+void dir_panel_move_cursor_up(struct dir_panel *dir_panel, unsigned count);
+void dir_panel_move_cursor_down(struct dir_panel *dir_panel, unsigned count);
 void dir_panel_select_or_unselect(struct dir_panel *dir_panel);
+void dir_panel_select_by_pattern(struct dir_panel *dir_panel, const char *pattern, int file_type, char is_selected);
+void dir_panel_select_all(struct dir_panel *dir_panel);
+void dir_panel_invert_selection(struct dir_panel *dir_panel);
+const char *dir_panel_selection_pattern(struct dir_panel *dir_panel);
 unsigned *dir_panel_selected_elem_indices(struct dir_panel *dir_panel, unsigned *count);
+unsigned *dir_panel_sorted_elem_indices(struct dir_panel *dir_panel);
+int dir_panel_find(struct dir_panel *dir_panel, const char *pattern, unsigned *sorted_index);
+void dir_panel_set_cursor(struct dir_panel *dir_panel, unsigned y);
 void dir_panel_set_status_to_unloaded(struct dir_panel *dir_panel);
 
 #endif
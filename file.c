@@ -15,27 +15,60 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <cbm.h>
+#include <errno.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include "cmd_channel.h"
 #include "file.h"
+#include "hiram.h"
+#include "reu.h"
+#include "util.h"
+
+#define WINDOW_LFN                      13
+#define WINDOW_SEC_ADDR                 4
+#define LOADER_LFN                      12
+
+struct file_loader
+{
+  unsigned char device;
+  char is_open;
+  unsigned capacity;
+};
 
 struct file view_file;
+struct file_window view_window;
 
-struct file loaded_file;
+static struct file_loader loader;
+
+struct chunked_file loaded_file;
 struct file_ext loaded_file_ext;
 
 void initialize_files(void)
 {
   view_file.content = NULL;
   view_file.size = 0;
-  loaded_file.content = NULL;
+  view_window.line_checkpoints = NULL;
+  view_window.is_in_reu = 0;
+  view_window.is_open = 0;
+  loader.is_open = 0;
+  loaded_file.is_loaded = 0;
+  loaded_file.uses_hiram = 1;
+  loaded_file.uses_reu = 1;
+  arena_init(&(loaded_file.arena), FILE_CHUNK_SIZE);
   loaded_file.size = 0;
+  loaded_file.hiram_size = 0;
+  loaded_file.reu_size = 0;
 }
 
 void finalize_files(void)
 {
+  file_load_close();
   if(view_file.content != NULL) free(view_file.content);
-  if(loaded_file.content != NULL) free(loaded_file.content);
+  file_window_free(&view_window);
+  chunked_file_free(&loaded_file);
 }
 
 void file_free(struct file *file)
@@ -46,3 +79,298 @@ void file_free(struct file *file)
     file->size = 0;
   }
 }
+
+static void close_window(struct file_window *window)
+{
+  if(window->is_open) {
+    cbm_close(WINDOW_LFN);
+    cmd_channel_close(window->device);
+    window->is_open = 0;
+  }
+}
+
+void file_window_free(struct file_window *window)
+{
+  if(window->line_checkpoints != NULL) {
+    free(window->line_checkpoints);
+    window->line_checkpoints = NULL;
+  }
+  close_window(window);
+  window->is_in_reu = 0;
+}
+
+void chunked_file_free(struct chunked_file *file)
+{
+  arena_free(&(file->arena));
+  file->is_loaded = 0;
+  file->size = 0;
+  file->hiram_size = 0;
+  file->reu_size = 0;
+}
+
+/*
+ * Appends the data to the file. Returns zero if there isn't enough memory, otherwise non-zero.
+ */
+/*
+ * Returns the estimated number of bytes that the file can hold after it is freed. This is the RAM
+ * under the ROMs, the whole REU memory, and the chunks that can be allocated from the free heap
+ * memory and the memory of the file chunks. Every chunk has its header and the header of the heap
+ * block.
+ */
+unsigned long chunked_file_capacity(const struct chunked_file *file)
+{
+  unsigned long capacity = 0;
+  unsigned long heap_size = _heapmemavail();
+  struct arena_chunk *chunk;
+  if(file->uses_hiram) capacity += HIRAM_SIZE;
+  if(file->uses_reu) capacity += reu_size();
+  for(chunk = file->arena.first_chunk; chunk != NULL; chunk = chunk->next)
+    heap_size += sizeof(struct arena_chunk) + sizeof(unsigned) + chunk->size;
+  capacity += heap_size / (sizeof(struct arena_chunk) + sizeof(unsigned) + FILE_CHUNK_SIZE) * FILE_CHUNK_SIZE;
+  return capacity;
+}
+
+char chunked_file_append(struct chunked_file *file, const char *buf, unsigned size)
+{
+  if(file->uses_hiram && file->reu_size == 0 && file->arena.first_chunk == NULL &&
+    file->hiram_size + size <= HIRAM_SIZE) {
+    hiram_write(file->hiram_size, buf, size);
+    file->hiram_size += size;
+  } else if(file->uses_reu && file->arena.first_chunk == NULL && reu_bank_count > 0 &&
+    REU_LOADED_FILE_ADDR + file->reu_size + size <= reu_size()) {
+    reu_stash(REU_LOADED_FILE_ADDR + file->reu_size, buf, size);
+    file->reu_size += size;
+  } else {
+    char *p = arena_alloc(&(file->arena), size);
+    if(p == NULL) return 0;
+    memcpy(p, buf, size);
+  }
+  file->size += size;
+  return 1;
+}
+
+void chunked_file_rewind(struct chunked_file *file)
+{
+  file->read_pos = 0;
+  file->read_chunk = file->arena.first_chunk;
+  file->read_chunk_offset = 0;
+}
+
+/*
+ * Reads the next data of the file. Returns the number of read bytes or zero at the end of the file.
+ */
+unsigned chunked_file_read(struct chunked_file *file, char *buf, unsigned size)
+{
+  unsigned len;
+  if(file->read_pos < file->hiram_size) {
+    len = umin(file->hiram_size - (unsigned) file->read_pos, size);
+    hiram_read(buf, file->read_pos, len);
+  } else if(file->read_pos - file->hiram_size < file->reu_size) {
+    unsigned long reu_pos = file->read_pos - file->hiram_size;
+    len = (file->reu_size - reu_pos < size ? file->reu_size - reu_pos : size);
+    reu_fetch(buf, REU_LOADED_FILE_ADDR + reu_pos, len);
+  } else {
+    while(file->read_chunk != NULL && file->read_chunk_offset >= file->read_chunk->used) {
+      file->read_chunk = file->read_chunk->next;
+      file->read_chunk_offset = 0;
+    }
+    if(file->read_chunk == NULL) return 0;
+    len = umin(file->read_chunk->used - file->read_chunk_offset, size);
+    memcpy(buf, arena_chunk_data(file->read_chunk) + file->read_chunk_offset, len);
+    file->read_chunk_offset += len;
+  }
+  file->read_pos += len;
+  return len;
+}
+
+static int open_window(struct file_window *window, const char **msg)
+{
+  static char cbm_file_name[16 + 1 + 3 + 1 + 1 + 1];
+  int res;
+  sprintf(cbm_file_name, "%s,%s,r", window->name, file_type_to_str_for_copy(window->type));
+  if(cbm_open(WINDOW_LFN, window->device, WINDOW_SEC_ADDR, cbm_file_name) != 0) {
+    cbm_close(WINDOW_LFN);
+    return -1;
+  }
+  res = cmd_channel_read(window->device, msg, 1);
+  if(res != 0) {
+    cbm_close(WINDOW_LFN);
+    if(res > 0) cmd_channel_close(window->device);
+    return res;
+  }
+  window->is_open = 1;
+  window->next_block = 0;
+  return 0;
+}
+
+/*
+ * Reads the blocks of the window into the file content from the first block. The file is kept open
+ * between reads, so a window after the previous window is read forward and the blocks that are
+ * already in the content are moved instead of read again. The file can't be seeked, so it is opened
+ * again and the blocks before the window are skipped only when the window moves backward.
+ */
+int file_read_window(struct file_window *window, struct file *file, unsigned first_block, const char **msg)
+{
+  unsigned loaded_block_count;
+  int res = 0;
+  if(window->is_in_reu) {
+    unsigned long start = (unsigned long) first_block * FILE_BLOCK_SIZE;
+    unsigned long end = start + (unsigned long) window->capacity_in_blocks * FILE_BLOCK_SIZE;
+    if(end > window->size) end = window->size;
+    file->size = end > start ? end - start : 0;
+    reu_fetch(file->content, window->reu_addr + start, file->size);
+    window->first_block = first_block;
+    return 0;
+  }
+  loaded_block_count = (file->size + FILE_BLOCK_SIZE - 1) / FILE_BLOCK_SIZE;
+  if(window->is_open && first_block >= window->first_block && first_block < window->next_block &&
+    window->first_block + loaded_block_count == window->next_block) {
+    unsigned skipped_size = (first_block - window->first_block) * FILE_BLOCK_SIZE;
+    file->size -= skipped_size;
+    memmove(file->content, file->content + skipped_size, file->size);
+  } else {
+    file->size = 0;
+    if(window->is_open && first_block < window->next_block) close_window(window);
+    if(!window->is_open) {
+      res = open_window(window, msg);
+      if(res != 0) return res;
+    }
+    for(; window->next_block < first_block; window->next_block++) {
+      res = cbm_read(WINDOW_LFN, file->content, FILE_BLOCK_SIZE);
+      if(res <= 0) break;
+    }
+  }
+  window->first_block = first_block;
+  if(res != -1) {
+    while(window->next_block < first_block + window->capacity_in_blocks) {
+      res = cbm_read(WINDOW_LFN, file->content + file->size, FILE_BLOCK_SIZE);
+      if(res <= 0) break;
+      file->size += res;
+      window->next_block++;
+    }
+  }
+  if(res == -1) {
+    file->size = 0;
+    close_window(window);
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * Opens the file for loading block by block. The content is allocated for the whole file at once.
+ * Returns 0 if the file is opened, -1 with the message for an error, or -2 if there isn't enough
+ * memory for the file.
+ */
+int file_load_open(struct file *file, unsigned char device, const char *file_name, unsigned char file_type, unsigned size_in_blocks, const char **msg)
+{
+  static char cbm_file_name[16 + 1 + 3 + 1 + 1 + 1];
+  int res;
+  file_free(file);
+  loader.capacity = (size_in_blocks + 1) * FILE_BLOCK_SIZE;
+  file->content = malloc(loader.capacity);
+  if(file->content == NULL) return -2;
+  sprintf(cbm_file_name, "%s,%s,r", file_name, file_type_to_str_for_copy(file_type));
+  if(cbm_open(LOADER_LFN, device, 0, cbm_file_name) != 0) {
+    *msg = _stroserror(_oserror);
+    cbm_close(LOADER_LFN);
+    file_free(file);
+    return -1;
+  }
+  res = cmd_channel_read(device, msg, 1);
+  if(res != 0) {
+    if(res == -1) *msg = _stroserror(_oserror);
+    cbm_close(LOADER_LFN);
+    if(res > 0) cmd_channel_close(device);
+    file_free(file);
+    return -1;
+  }
+  loader.device = device;
+  loader.is_open = 1;
+  return 0;
+}
+
+/*
+ * Loads the next block of the file. Returns the number of the loaded bytes, 0 for the end of the
+ * file, or -1 with the message for an error.
+ */
+int file_load_next(struct file *file, const char **msg)
+{
+  int res;
+  if(file->size + FILE_BLOCK_SIZE > loader.capacity) {
+    char *content = realloc(file->content, loader.capacity + FILE_BLOCK_SIZE);
+    if(content == NULL) {
+      *msg = "Out of memory";
+      return -1;
+    }
+    file->content = content;
+    loader.capacity += FILE_BLOCK_SIZE;
+  }
+  res = cbm_read(LOADER_LFN, file->content + file->size, FILE_BLOCK_SIZE);
+  if(res == -1) {
+    *msg = _stroserror(_oserror);
+    return -1;
+  }
+  file->size += res;
+  return res;
+}
+
+void file_load_close(void)
+{
+  if(loader.is_open) {
+    cbm_close(LOADER_LFN);
+    cmd_channel_close(loader.device);
+    loader.is_open = 0;
+  }
+}
+
+char file_is_loading(void)
+{ return loader.is_open; }
+
+char is_file_type_for_copy(unsigned char file_type)
+{ return file_type == _CBM_T_SEQ || file_type == _CBM_T_PRG || file_type == _CBM_T_USR; }
+
+char *file_type_to_str_for_copy(unsigned char file_type)
+{
+  switch(file_type) {
+  case _CBM_T_SEQ:
+    return "s";
+  case _CBM_T_USR:
+    return "u";
+  default:
+    return "p";
+  }
+}
+
+char *file_type_to_str_for_copy2(int file_type, unsigned char default_file_type)
+{
+  if(file_type == -1)
+    return file_type_to_str_for_copy(default_file_type);
+  else
+    return file_type_to_str_for_copy(file_type);
+}
+
+int file_rename(unsigned char device, const char *old_file_name, const char *new_file_name, const char **msg)
+{
+  static char buf[16 + 1 + 16 + 2 + 1];
+  sprintf(buf, "r:%s=%s", new_file_name, old_file_name);
+  return cmd_channel_execute(device, buf, msg);
+}
+
+int file_delete(unsigned char device, const char *file_name, const char **msg)
+{
+  static char buf[16 + 2 + 1];
+  sprintf(buf, "s:%s", file_name);
+  return cmd_channel_execute(device, buf, msg);
+}
+
+/*
+ * Copies the file by the device, so file data isn't transferred by the bus. The source file and the
+ * destination file must be on the same device.
+ */
+int file_copy_by_device(unsigned char device, const char *src_file_name, const char *dst_file_name, const char **msg)
+{
+  static char buf[16 + 1 + 16 + 2 + 1];
+  sprintf(buf, "c:%s=%s", dst_file_name, src_file_name);
+  return cmd_channel_execute(device, buf, msg);
+}
@@ -18,12 +18,60 @@
 #ifndef _FILE_H
 #define _FILE_H
 
+#include "arena.h"
+
+#define FILE_BLOCK_SIZE                 256
+#define FILE_CHUNK_SIZE                 (FILE_BLOCK_SIZE * 4)
+
 struct file
 {
   char *content;
   unsigned size;
 };
 
+/*
+ * A file that is stored in the chunks of an arena. The chunks aren't moved when the file grows, so
+ * loading of the file doesn't reallocate its content. A file that uses the RAM under the ROMs and
+ * the REU is first stored in this RAM, then in the REU if it is present, and its rest is stored in
+ * the arena. The file is read sequentially from its start after chunked_file_rewind.
+ */
+struct chunked_file
+{
+  char is_loaded;
+  char uses_hiram;
+  char uses_reu;
+  struct arena arena;
+  unsigned long size;
+  unsigned hiram_size;
+  unsigned long reu_size;
+  unsigned long read_pos;
+  struct arena_chunk *read_chunk;
+  unsigned read_chunk_offset;
+};
+
+/*
+ * A file that is viewed by a window of its blocks. The line checkpoints hold the line number of
+ * the first byte of every block and one more entry for the end of the file. If all blocks are kept
+ * in the REU from the REU address, the window is read from the REU instead of the disk. The next block is the block
+ * that is read next from the open file.
+ */
+struct file_window
+{
+  unsigned char device;
+  char name[17];
+  unsigned char type;
+  unsigned block_count;
+  unsigned long size;
+  unsigned *line_checkpoints;
+  unsigned max_line_char_count;
+  unsigned first_block;
+  unsigned capacity_in_blocks;
+  char is_in_reu;
+  unsigned long reu_addr;
+  char is_open;
+  unsigned next_block;
+};
+
 struct file_ext
 {
   char name[17];
@@ -32,8 +80,9 @@ struct file_ext
 };
 
 extern struct file view_file;
+extern struct file_window view_window;
 
-extern struct file loaded_file;
+extern struct chunked_file loaded_file;
 extern struct file_ext loaded_file_ext;
 
 
@@ -41,5 +90,24 @@ void initialize_files(void);
 void finalize_files(void);
 
 void file_free(struct file *file);
+void file_window_free(struct file_window *window);
+void chunked_file_free(struct chunked_file *file);
+unsigned long chunked_file_capacity(const struct chunked_file *file);
+char chunked_file_append(struct chunked_file *file, const char *buf, unsigned size);
+void chunked_file_rewind(struct chunked_file *file);
+unsigned chunked_file_read(struct chunked_file *file, char *buf, unsigned size);
+int file_load_open(struct file *file, unsigned char device, const char *file_name, unsigned char file_type, unsigned size_in_blocks, const char **msg);
+int file_load_next(struct file *file, const char **msg);
+void file_load_close(void);
+char file_is_loading(void);
+int file_read_window(struct file_window *window, struct file *file, unsigned first_block, const char **msg);
+
+char is_file_type_for_copy(unsigned char file_type);
+char *file_type_to_str_for_copy(unsigned char file_type);
+char *file_type_to_str_for_copy2(int file_type, unsigned char default_file_type);
+
+int file_rename(unsigned char device, const char *old_file_name, const char *new_file_name, const char **msg);
+int file_delete(unsigned char device, const char *file_name, const char **msg);
+int file_copy_by_device(unsigned char device, const char *src_file_name, const char *dst_file_name, const char **msg);
 
 #endif
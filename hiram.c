@@ -0,0 +1,71 @@
+/*
+ * Simple file manager for Commodore 64.
+ * Copyright (C) 2019 Łukasz Szpakowski
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <6502.h>
+#include <string.h>
+#include "hiram.h"
+
+/*
+ * The RAM under the ROMs is only accessed by copying with interrupts disabled and all ROMs banked
+ * out, so the KERNAL is never called while this RAM is visible. The NMI vector in this RAM points
+ * to RTI, so the RESTORE key doesn't jump to garbage while the ROMs are banked out.
+ */
+#define HIRAM                           ((unsigned char *) 0xd000)
+#define HIRAM_RTI_ADDR                  0xfff0
+#define HIRAM_RTI                       ((unsigned char *) HIRAM_RTI_ADDR)
+#define HIRAM_NMI_VECTOR                ((unsigned char *) 0xfffa)
+
+#define CPU_PORT                        (*((unsigned char *) 0x0001))
+#define CPU_PORT_ALL_RAM                0x04
+
+static unsigned char saved_cpu_port;
+
+static void bank_out_roms(void)
+{
+  SEI();
+  saved_cpu_port = CPU_PORT;
+  CPU_PORT = (saved_cpu_port & ~0x07) | CPU_PORT_ALL_RAM;
+}
+
+static void bank_in_roms(void)
+{
+  CPU_PORT = saved_cpu_port;
+  CLI();
+}
+
+void initialize_hiram(void)
+{
+  bank_out_roms();
+  HIRAM_RTI[0] = 0x40;
+  HIRAM_NMI_VECTOR[0] = HIRAM_RTI_ADDR & 0xff;
+  HIRAM_NMI_VECTOR[1] = HIRAM_RTI_ADDR >> 8;
+  bank_in_roms();
+}
+
+void hiram_read(void *dst, unsigned offset, unsigned size)
+{
+  bank_out_roms();
+  memcpy(dst, HIRAM + offset, size);
+  bank_in_roms();
+}
+
+void hiram_write(unsigned offset, const void *src, unsigned size)
+{
+  bank_out_roms();
+  memcpy(HIRAM + offset, src, size);
+  bank_in_roms();
+}
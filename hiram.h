@@ -0,0 +1,32 @@
+/*
+ * Simple file manager for Commodore 64.
+ * Copyright (C) 2019 Łukasz Szpakowski
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _HIRAM_H
+#define _HIRAM_H
+
+/*
+ * The RAM under the I/O area and the KERNAL from $D000 to $FEFF. The last page is left for the CPU
+ * vectors.
+ */
+#define HIRAM_SIZE                      0x2f00
+
+void initialize_hiram(void);
+
+void hiram_read(void *dst, unsigned offset, unsigned size);
+void hiram_write(unsigned offset, const void *src, unsigned size);
+
+#endif
@@ -0,0 +1,706 @@
+/*
+ * Simple file manager for Commodore 64.
+ * Copyright (C) 2019 Łukasz Szpakowski
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cbm.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cmd_channel.h"
+#include "dir_panel.h"
+#include "file.h"
+#include "job.h"
+#include "util.h"
+
+#define BUFFER_SIZE                     256
+#define CMD_MAX                         40
+#define CMD_FILE_NAME_MAX               5
+#define DIR_ENTRIES_PER_STEP            8
+
+#define JOB_STATE_START                 0
+#define JOB_STATE_COPY                  1
+#define JOB_STATE_START_VERIFY          2
+#define JOB_STATE_VERIFY                3
+#define JOB_STATE_LOAD_DIR              4
+#define JOB_STATE_CHECK_PATTERN         5
+#define JOB_STATE_DELETE                6
+
+#define SRC_LFN                         2
+#define DST_LFN                         3
+#define DIR_LFN                         4
+#define SRC_SEC_ADDR                    2
+#define DST_SEC_ADDR                    3
+
+static struct job *first_job;
+static struct job *last_job;
+static struct job *first_stopped_copy_job;
+static struct job *last_stopped_copy_job;
+static char status[48];
+static const char *message_title;
+static char message[40];
+static char has_message;
+static char cbm_file_name[16 + 1 + 3 + 1 + 1 + 1];
+static char buf[BUFFER_SIZE];
+
+void initialize_jobs(void)
+{
+  first_job = NULL;
+  last_job = NULL;
+  first_stopped_copy_job = NULL;
+  last_stopped_copy_job = NULL;
+  message_title = NULL;
+  has_message = 0;
+}
+
+void job_free(struct job *job)
+{
+  if(job->entries != NULL) free(job->entries);
+  free(job);
+}
+
+void finalize_jobs(void)
+{
+  while(first_job != NULL) {
+    job_stop();
+  }
+  while(first_stopped_copy_job != NULL) {
+    struct job *job = first_stopped_copy_job;
+    first_stopped_copy_job = job->next;
+    job_free(job);
+  }
+}
+
+struct job *job_new(unsigned char type, unsigned entry_count)
+{
+  struct job *job = malloc(sizeof(struct job));
+  if(job == NULL) return NULL;
+  job->type = type;
+  job->state = JOB_STATE_START;
+  job->src_device = 0;
+  job->dst_device = 0;
+  job->dst_file_type = -1;
+  job->is_verify = 0;
+  job->are_many_files = 0;
+  job->has_pattern = 0;
+  job->dst_file_name[0] = 0;
+  job->dst_prefix[0] = 0;
+  job->dst_suffix[0] = 0;
+  job->entries = NULL;
+  job->entry_count = entry_count;
+  job->entry_index = 0;
+  job->dir_panel = NULL;
+  job->next = NULL;
+  if(entry_count > 0) {
+    job->entries = malloc(sizeof(struct cbm_dirent) * entry_count);
+    if(job->entries == NULL) {
+      free(job);
+      return NULL;
+    }
+  }
+  return job;
+}
+
+void job_add(struct job *job)
+{
+  job->next = NULL;
+  if(last_job != NULL)
+    last_job->next = job;
+  else
+    first_job = job;
+  last_job = job;
+}
+
+char job_add_prefetch(struct dir_panel *dir_panel)
+{
+  struct job *job = job_new(JOB_TYPE_PREFETCH, 0);
+  if(job == NULL) return 0;
+  job->dir_panel = dir_panel;
+  job_add(job);
+  return 1;
+}
+
+char job_is_running(void)
+{ return first_job != NULL; }
+
+static char does_job_use_device(struct job *job, unsigned char device)
+{
+  switch(job->type) {
+  case JOB_TYPE_COPY:
+    return job->src_device == device || job->dst_device == device;
+  case JOB_TYPE_PREFETCH:
+    return job->dir_panel->device == device;
+  default:
+    return job->src_device == device;
+  }
+}
+
+/*
+ * Checks all jobs in the queue, because a queued job uses the device when it is started later.
+ */
+char job_is_device_busy(unsigned char device)
+{
+  struct job *job;
+  for(job = first_job; job != NULL; job = job->next) {
+    if(does_job_use_device(job, device)) return 1;
+  }
+  return 0;
+}
+
+static void set_message(const char *title, const char *msg)
+{
+  message_title = title;
+  strncpy(message, msg, sizeof(message) - 1);
+  message[sizeof(message) - 1] = 0;
+  has_message = 1;
+}
+
+/*
+ * Unloads the directory of the device after changes. The directory of the current directory panel is
+ * loaded again by a prefetch job.
+ */
+static void refresh_dir_panel(unsigned char device)
+{
+  struct dir_panel *dir_panel = &dir_panels[device - 8];
+  dir_panel_set_status_to_unloaded(dir_panel);
+  if(dir_panel == current_dir_panel) job_add_prefetch(dir_panel);
+}
+
+static void remove_first_job(void)
+{
+  struct job *job = first_job;
+  first_job = job->next;
+  if(first_job == NULL) last_job = NULL;
+  job->next = NULL;
+  if(job->type == JOB_TYPE_COPY && job->entry_index < job->entry_count) {
+    /* The stopped copy jobs are kept in the list, so all of them can be resumed. */
+    job->state = JOB_STATE_START;
+    if(last_stopped_copy_job != NULL)
+      last_stopped_copy_job->next = job;
+    else
+      first_stopped_copy_job = job;
+    last_stopped_copy_job = job;
+  } else
+    job_free(job);
+}
+
+/*
+ * A copy job.
+ */
+
+static void close_src_and_dst(struct job *job)
+{
+  cbm_close(DST_LFN);
+  cmd_channel_close(job->dst_device);
+  cbm_close(SRC_LFN);
+  cmd_channel_close(job->src_device);
+}
+
+static char stop_copying(struct job *job)
+{
+  refresh_dir_panel(job->dst_device);
+  return 1;
+}
+
+static char copy_next_file(struct job *job)
+{
+  job->entry_index++;
+  job->state = JOB_STATE_START;
+  return 0;
+}
+
+static char start_copying(struct job *job)
+{
+  struct cbm_dirent *entry = &(job->entries[job->entry_index]);
+  unsigned char res;
+  int res2;
+  const char *error;
+  if(job->are_many_files) {
+    job->current_dst_file_name[0] = 0;
+    strcat(job->current_dst_file_name, job->dst_prefix);
+    strcat(job->current_dst_file_name, entry->name);
+    strcat(job->current_dst_file_name, job->dst_suffix);
+  } else
+    strcpy(job->current_dst_file_name, job->dst_file_name);
+  job->blocks = 0;
+  if(job->src_device == job->dst_device && !job->is_verify && (job->dst_file_type == -1 || job->dst_file_type == entry->type)) {
+    res2 = file_delete(job->dst_device, job->current_dst_file_name, &error);
+    if(res2 != -1) res2 = file_copy_by_device(job->dst_device, entry->name, job->current_dst_file_name, &error);
+    if(res2 == -1) {
+      set_message("Error", _stroserror(_oserror));
+      return stop_copying(job);
+    } else if(res2 > 0) {
+      set_message("Error", error);
+      return stop_copying(job);
+    }
+    return copy_next_file(job);
+  }
+  sprintf(cbm_file_name, "%s,%s,r", entry->name, file_type_to_str_for_copy(entry->type));
+  res = cbm_open(SRC_LFN, job->src_device, SRC_SEC_ADDR, cbm_file_name);
+  if(res != 0) {
+    set_message("Error", _stroserror(_oserror));
+    cbm_close(SRC_LFN);
+    return stop_copying(job);
+  }
+  res2 = cmd_channel_read(job->src_device, &error, 1);
+  if(res2 == -1) {
+    set_message("Error", _stroserror(_oserror));
+    cbm_close(SRC_LFN);
+    return stop_copying(job);
+  } else if(res2 > 0) {
+    set_message("Error", error);
+    cbm_close(SRC_LFN);
+    cmd_channel_close(job->src_device);
+    return stop_copying(job);
+  }
+  res2 = file_delete(job->dst_device, job->current_dst_file_name, &error);
+  if(res2 == -1) {
+    set_message("Error", _stroserror(_oserror));
+    cbm_close(SRC_LFN);
+    cmd_channel_close(job->src_device);
+    return stop_copying(job);
+  }
+  sprintf(cbm_file_name, "%s,%s,w", job->current_dst_file_name, file_type_to_str_for_copy2(job->dst_file_type, entry->type));
+  res = cbm_open(DST_LFN, job->dst_device, DST_SEC_ADDR, cbm_file_name);
+  if(res != 0) {
+    set_message("Error", _stroserror(_oserror));
+    cbm_close(DST_LFN);
+    cbm_close(SRC_LFN);
+    cmd_channel_close(job->src_device);
+    return stop_copying(job);
+  }
+  res2 = cmd_channel_read(job->dst_device, &error, 1);
+  if(res2 == -1) {
+    set_message("Error", _stroserror(_oserror));
+    cbm_close(DST_LFN);
+    cbm_close(SRC_LFN);
+    cmd_channel_close(job->src_device);
+    return stop_copying(job);
+  } else if(res2 > 0) {
+    set_message("Error", error);
+    close_src_and_dst(job);
+    return stop_copying(job);
+  }
+  job->crc = CRC16_INITIAL_VALUE;
+  job->bytes = 0;
+  job->state = JOB_STATE_COPY;
+  return 0;
+}
+
+static char copy_block(struct job *job)
+{
+  int res2, res3;
+  res2 = cbm_read(SRC_LFN, buf, BUFFER_SIZE);
+  if(res2 == -1) {
+    set_message("Error", _stroserror(_oserror));
+    close_src_and_dst(job);
+    return stop_copying(job);
+  } else if(res2 == 0) {
+    close_src_and_dst(job);
+    if(job->is_verify) {
+      job->state = JOB_STATE_START_VERIFY;
+      return 0;
+    }
+    return copy_next_file(job);
+  }
+  res3 = cbm_write(DST_LFN, buf, res2);
+  if(res3 == -1) {
+    set_message("Error", _stroserror(_oserror));
+    close_src_and_dst(job);
+    return stop_copying(job);
+  }
+  if(job->is_verify) {
+    job->crc = crc16_update(job->crc, buf, res2);
+    job->bytes += res2;
+  }
+  job->blocks++;
+  return 0;
+}
+
+/*
+ * The copied file is read back and is verified by comparison its CRC with the CRC that is computed
+ * while copying, so the source file isn't read twice. A mismatch is reported for each file that
+ * differs and the job continues with the next file.
+ */
+static char start_verifying(struct job *job)
+{
+  struct cbm_dirent *entry = &(job->entries[job->entry_index]);
+  unsigned char res;
+  int res2;
+  const char *error;
+  sprintf(cbm_file_name, "%s,%s,r", job->current_dst_file_name, file_type_to_str_for_copy2(job->dst_file_type, entry->type));
+  res = cbm_open(DST_LFN, job->dst_device, DST_SEC_ADDR, cbm_file_name);
+  if(res != 0) {
+    set_message("Error", _stroserror(_oserror));
+    cbm_close(DST_LFN);
+    return stop_copying(job);
+  }
+  res2 = cmd_channel_read(job->dst_device, &error, 1);
+  if(res2 == -1) {
+    set_message("Error", _stroserror(_oserror));
+    cbm_close(DST_LFN);
+    return stop_copying(job);
+  } else if(res2 > 0) {
+    set_message("Error", error);
+    cbm_close(DST_LFN);
+    cmd_channel_close(job->dst_device);
+    return stop_copying(job);
+  }
+  job->dst_crc = CRC16_INITIAL_VALUE;
+  job->dst_bytes = 0;
+  job->blocks = 0;
+  job->state = JOB_STATE_VERIFY;
+  return 0;
+}
+
+static char verify_block(struct job *job)
+{
+  static char mismatch_msg[16 + 16 + 1];
+  int res2;
+  res2 = cbm_read(DST_LFN, buf, BUFFER_SIZE);
+  if(res2 == -1) {
+    set_message("Error", _stroserror(_oserror));
+    cbm_close(DST_LFN);
+    cmd_channel_close(job->dst_device);
+    return stop_copying(job);
+  } else if(res2 == 0) {
+    cbm_close(DST_LFN);
+    cmd_channel_close(job->dst_device);
+    if(job->dst_crc != job->crc || job->dst_bytes != job->bytes) {
+      sprintf(mismatch_msg, "Files differ: %s", job->current_dst_file_name);
+      set_message("Verify", mismatch_msg);
+    }
+    return copy_next_file(job);
+  }
+  job->dst_crc = crc16_update(job->dst_crc, buf, res2);
+  job->dst_bytes += res2;
+  job->blocks++;
+  return 0;
+}
+
+static char copy_step(struct job *job)
+{
+  if(job->entry_index >= job->entry_count) {
+    refresh_dir_panel(job->dst_device);
+    return 1;
+  }
+  switch(job->state) {
+  case JOB_STATE_START:
+    return start_copying(job);
+  case JOB_STATE_COPY:
+    return copy_block(job);
+  case JOB_STATE_START_VERIFY:
+    return start_verifying(job);
+  default:
+    return verify_block(job);
+  }
+}
+
+/*
+ * A delete job. Files are deleted by as few scratch commands as possible. If the files are selected by
+ * the pattern, they are deleted by one scratch command with this pattern, otherwise several file names
+ * are passed to each scratch command. The scratch command with the pattern acts on the current
+ * directory of the device rather than the directory panel, so the pattern is used only if the files
+ * that match the pattern on the device are the selected files.
+ */
+
+static char is_job_entry(struct job *job, const char *file_name)
+{
+  unsigned i;
+  for(i = 0; i < job->entry_count; i++) {
+    if(strcmp(job->entries[i].name, file_name) == 0) return 1;
+  }
+  return 0;
+}
+
+static void stop_checking_pattern(struct job *job, char is_matched)
+{
+  cbm_closedir(DIR_LFN);
+  cmd_channel_close(job->src_device);
+  if(!is_matched) job->has_pattern = 0;
+  job->state = JOB_STATE_DELETE;
+}
+
+static void start_checking_pattern(struct job *job)
+{
+  int res;
+  const char *error;
+  job->state = JOB_STATE_DELETE;
+  sprintf(cbm_file_name, "$:%s", job->pattern);
+  if(cbm_opendir(DIR_LFN, job->src_device, cbm_file_name) != 0) {
+    cbm_closedir(DIR_LFN);
+    job->has_pattern = 0;
+    return;
+  }
+  res = cmd_channel_read(job->src_device, &error, 1);
+  if(res != 0) {
+    cbm_closedir(DIR_LFN);
+    if(res > 0) cmd_channel_close(job->src_device);
+    job->has_pattern = 0;
+    return;
+  }
+  job->matched_entry_count = 0;
+  job->state = JOB_STATE_CHECK_PATTERN;
+}
+
+static void check_pattern(struct job *job)
+{
+  static struct cbm_dirent entry;
+  unsigned char i;
+  unsigned char res;
+  for(i = 0; i < DIR_ENTRIES_PER_STEP; i++) {
+    res = cbm_readdir(DIR_LFN, &entry);
+    if(res == 0) {
+      if(entry.type == _CBM_T_HEADER) continue;
+      if(!is_job_entry(job, entry.name)) {
+        stop_checking_pattern(job, 0);
+        return;
+      }
+      job->matched_entry_count++;
+    } else if(res != 2) {
+      stop_checking_pattern(job, job->matched_entry_count == job->entry_count);
+      return;
+    }
+  }
+}
+
+static char delete_step(struct job *job)
+{
+  static char cmd[CMD_MAX + 1];
+  int res;
+  const char *error;
+  if(job->has_pattern) {
+    if(job->state == JOB_STATE_START) {
+      start_checking_pattern(job);
+      return 0;
+    } else if(job->state == JOB_STATE_CHECK_PATTERN) {
+      check_pattern(job);
+      return 0;
+    }
+  }
+  if(job->entry_index >= job->entry_count) {
+    refresh_dir_panel(job->src_device);
+    return 1;
+  }
+  strcpy(cmd, "s:");
+  if(job->has_pattern) {
+    strcat(cmd, job->pattern);
+    job->entry_index = job->entry_count;
+  } else {
+    unsigned char file_name_count = 0;
+    while(job->entry_index < job->entry_count && file_name_count < CMD_FILE_NAME_MAX) {
+      char *file_name = job->entries[job->entry_index].name;
+      if(file_name_count > 0) {
+        if(strlen(cmd) + 1 + strlen(file_name) > CMD_MAX) break;
+        strcat(cmd, ",");
+      }
+      strcat(cmd, file_name);
+      file_name_count++;
+      job->entry_index++;
+    }
+  }
+  res = cmd_channel_execute(job->src_device, cmd, &error);
+  if(res == -1) {
+    set_message("Error", _stroserror(_oserror));
+    refresh_dir_panel(job->src_device);
+    return 1;
+  } else if(res > 0) {
+    set_message("Error", error);
+    refresh_dir_panel(job->src_device);
+    return 1;
+  }
+  return 0;
+}
+
+/*
+ * A rename job.
+ */
+
+static char rename_step(struct job *job)
+{
+  struct cbm_dirent *entry;
+  int res;
+  const char *error;
+  if(job->entry_index >= job->entry_count) {
+    refresh_dir_panel(job->src_device);
+    return 1;
+  }
+  entry = &(job->entries[job->entry_index]);
+  if(job->are_many_files) {
+    job->current_dst_file_name[0] = 0;
+    strcat(job->current_dst_file_name, job->dst_prefix);
+    strcat(job->current_dst_file_name, entry->name);
+    strcat(job->current_dst_file_name, job->dst_suffix);
+  } else
+    strcpy(job->current_dst_file_name, job->dst_file_name);
+  res = file_rename(job->src_device, entry->name, job->current_dst_file_name, &error);
+  if(res == -1) {
+    set_message("Error", _stroserror(_oserror));
+    refresh_dir_panel(job->src_device);
+    return 1;
+  } else if(res > 0) {
+    set_message("Error", error);
+    refresh_dir_panel(job->src_device);
+    return 1;
+  }
+  job->entry_index++;
+  return 0;
+}
+
+/*
+ * A prefetch job loads the directory of the directory panel if it isn't loaded.
+ */
+
+static char prefetch_step(struct job *job)
+{
+  unsigned char i;
+  if(job->state == JOB_STATE_START) {
+    if(job->dir_panel->status != DIR_PANEL_STATUS_UNLOADED) return 1;
+    job->state = JOB_STATE_LOAD_DIR;
+    return !dir_panel_start_loading(job->dir_panel, DIR_LFN);
+  }
+  for(i = 0; i < DIR_ENTRIES_PER_STEP; i++) {
+    if(!dir_panel_load_next(job->dir_panel)) return 1;
+  }
+  return 0;
+}
+
+/*
+ * Steps the running job. The job waits while its message isn't taken, so a next message doesn't
+ * overwrite this message.
+ */
+void job_step(void)
+{
+  struct job *job = first_job;
+  char is_finished;
+  if(job == NULL || has_message) return;
+  switch(job->type) {
+  case JOB_TYPE_COPY:
+    is_finished = copy_step(job);
+    break;
+  case JOB_TYPE_DELETE:
+    is_finished = delete_step(job);
+    break;
+  case JOB_TYPE_RENAME:
+    is_finished = rename_step(job);
+    break;
+  default:
+    is_finished = prefetch_step(job);
+    break;
+  }
+  if(is_finished) remove_first_job();
+}
+
+/*
+ * Stops the running job. Files of the copy job are closed and the partial destination file is
+ * deleted. The stopped copy job can be resumed from the first file that isn't copied.
+ */
+void job_stop(void)
+{
+  struct job *job = first_job;
+  const char *error;
+  if(job == NULL) return;
+  switch(job->type) {
+  case JOB_TYPE_COPY:
+    if(job->state == JOB_STATE_COPY) {
+      close_src_and_dst(job);
+      file_delete(job->dst_device, job->current_dst_file_name, &error);
+    } else if(job->state == JOB_STATE_VERIFY) {
+      cbm_close(DST_LFN);
+      cmd_channel_close(job->dst_device);
+    }
+    refresh_dir_panel(job->dst_device);
+    break;
+  case JOB_TYPE_DELETE:
+    if(job->state == JOB_STATE_CHECK_PATTERN) {
+      cbm_closedir(DIR_LFN);
+      cmd_channel_close(job->src_device);
+    }
+    refresh_dir_panel(job->src_device);
+    break;
+  case JOB_TYPE_RENAME:
+    refresh_dir_panel(job->src_device);
+    break;
+  default:
+    if(job->state == JOB_STATE_LOAD_DIR) dir_panel_stop_loading(job->dir_panel);
+    break;
+  }
+  remove_first_job();
+}
+
+/*
+ * Resumes all stopped copy jobs in the order in which they were stopped.
+ */
+char job_resume(void)
+{
+  if(first_stopped_copy_job == NULL) return 0;
+  while(first_stopped_copy_job != NULL) {
+    struct job *job = first_stopped_copy_job;
+    first_stopped_copy_job = job->next;
+    job_add(job);
+  }
+  last_stopped_copy_job = NULL;
+  return 1;
+}
+
+unsigned job_stopped_file_count(void)
+{
+  struct job *job;
+  unsigned count = 0;
+  for(job = first_stopped_copy_job; job != NULL; job = job->next) {
+    count += job->entry_count - job->entry_index;
+  }
+  return count;
+}
+
+const char *job_status(void)
+{
+  struct job *job = first_job;
+  struct cbm_dirent *entry;
+  unsigned percent;
+  if(job == NULL) return NULL;
+  switch(job->type) {
+  case JOB_TYPE_COPY:
+    if(job->entry_index >= job->entry_count) return NULL;
+    entry = &(job->entries[job->entry_index]);
+    if(entry->size != 0)
+      percent = umin(100, (((unsigned long) job->blocks) * 100) / entry->size);
+    else
+      percent = 0;
+    sprintf(status, "%s %s %u/%u %u%%", (job->state >= JOB_STATE_START_VERIFY ? "Verify" : "Copy"), entry->name, job->entry_index + 1, job->entry_count, percent);
+    break;
+  case JOB_TYPE_DELETE:
+    sprintf(status, "Delete %u/%u", job->entry_index, job->entry_count);
+    break;
+  case JOB_TYPE_RENAME:
+    if(job->entry_index >= job->entry_count) return NULL;
+    sprintf(status, "Rename %s %u/%u", job->entries[job->entry_index].name, job->entry_index + 1, job->entry_count);
+    break;
+  default:
+    sprintf(status, "Prefetch dir of dev%02u", (unsigned) (job->dir_panel->device));
+    break;
+  }
+  return status;
+}
+
+const char *job_message(const char **title)
+{
+  if(!has_message) return NULL;
+  has_message = 0;
+  *title = message_title;
+  return message;
+}
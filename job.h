@@ -0,0 +1,82 @@
+/*
+ * Simple file manager for Commodore 64.
+ * Copyright (C) 2019 Łukasz Szpakowski
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _JOB_H
+#define _JOB_H
+
+#include <cbm.h>
+
+#define JOB_TYPE_COPY                   0
+#define JOB_TYPE_DELETE                 1
+#define JOB_TYPE_RENAME                 2
+#define JOB_TYPE_PREFETCH               3
+
+struct dir_panel;
+
+/*
+ * A job is advanced by steps between keyboard polls. Each step transfers at most one block, so
+ * the user interface isn't blocked by transfers. The jobs are executed one by one, so only one job
+ * uses the bus at a time.
+ *
+ * For a rename job, the destination file name, the destination prefix and the destination suffix
+ * are the new file name, the new prefix and the new suffix.
+ */
+struct job
+{
+  unsigned char type;
+  unsigned char state;
+  unsigned char src_device;
+  unsigned char dst_device;
+  int dst_file_type;
+  char is_verify;
+  char are_many_files;
+  char has_pattern;
+  char pattern[17];
+  char dst_file_name[17];
+  char dst_prefix[17];
+  char dst_suffix[17];
+  struct cbm_dirent *entries;
+  unsigned entry_count;
+  unsigned entry_index;
+  struct dir_panel *dir_panel;
+  char current_dst_file_name[17];
+  unsigned blocks;
+  unsigned crc;
+  unsigned long bytes;
+  unsigned dst_crc;
+  unsigned long dst_bytes;
+  unsigned matched_entry_count;
+  struct job *next;
+};
+
+void initialize_jobs(void);
+void finalize_jobs(void);
+
+struct job *job_new(unsigned char type, unsigned entry_count);
+void job_free(struct job *job);
+void job_add(struct job *job);
+char job_add_prefetch(struct dir_panel *dir_panel);
+char job_is_running(void);
+char job_is_device_busy(unsigned char device);
+void job_step(void);
+void job_stop(void);
+char job_resume(void);
+unsigned job_stopped_file_count(void);
+const char *job_status(void);
+const char *job_message(const char **title);
+
+#endif
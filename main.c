@@ -19,15 +19,21 @@
 #include "dialog.h"
 #include "dir_panel.h"
 #include "file.h"
+#include "hiram.h"
+#include "job.h"
 #include "main_menu.h"
+#include "reu.h"
 #include "screen.h"
 #include "text.h"
 
 int main(void)
 {
   initialize_cmd_channels();
+  initialize_hiram();
+  initialize_reu();
   initialize_screen();
   initialize_dir_panels();
+  initialize_jobs();
   initialize_dialogs();
   initialize_files();
   initialize_text();
@@ -37,6 +43,7 @@ int main(void)
   finalize_text();
   finalize_files();
   finalize_dialogs();
+  finalize_jobs();
   finalize_dir_panels();
   finalize_screen();
   finalize_cmd_channels();
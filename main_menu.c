@@ -21,39 +21,199 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include "cmd_channel.h"
 #include "dialog.h"
 #include "dir_panel.h"
 #include "file.h"
+#include "job.h"
 #include "main_menu.h"
+#include "reu.h"
 #include "screen.h"
+#include "search.h"
 #include "text.h"
 #include "util.h"
 #include "view_menu.h"
 
 #define BUFFER_SIZE                     256
+#define DISK_BLOCK_DATA_SIZE            254
+#define VIEW_WINDOW_MAX_BLOCKS          64
+#define VIEW_WINDOW_MIN_BLOCKS          8
 #define PROGRESS_MAX                    18
+#define PROGRESS_INTERVAL               (CLOCKS_PER_SEC / 4)
+#define REMAINING_TIME_MAX              (99 * 60 + 59)
+#define TRANSFER_INFO_MAX               16
+#define GREP_RESULT_MAX                 32
+#define GREP_LABEL_LEN                  (16 + 1 + 10)
+#define HELP_LABEL_COUNT                12
+
+/*
+ * A transfer meter updates the progress of loading or saving. The progress is drawn at most four times
+ * per second, so the progress bar is only computed from the transferred blocks when it's drawn. The
+ * last block is always drawn, so the progress bar is full at the end.
+ */
+struct transfer_meter
+{
+  struct progress *progress;
+  unsigned size_in_blocks;
+  clock_t start_time;
+  clock_t draw_time;
+};
+
+/*
+ * A grep result is the file and the offset of the first match in the file. The label has room for
+ * the longest offset of ten digits.
+ */
+struct grep_result
+{
+  struct cbm_dirent entry;
+  unsigned long offset;
+  char label[GREP_LABEL_LEN + 1];
+};
+
+static struct transfer_meter transfer_meter;
+static char transfer_info[TRANSFER_INFO_MAX + 1];
+static clock_t job_status_time;
+
+static struct grep_result grep_results[GREP_RESULT_MAX];
+static const char *grep_labels[GREP_RESULT_MAX];
+static unsigned grep_result_count;
+static unsigned char grep_device;
+
+static char find_pattern[17];
+static char has_found_file;
+static unsigned char found_dir_panel_index;
+static unsigned found_sorted_index;
 
 void main_menu_draw(void)
 {
   static char *menu[MAIN_MENU_HEIGHT] = {
     "8-8  9-9  R-Reload dir C-Copy N-Rename  ",
     "0-10 1-11 D-Delete L-Load S-Save F-Free ",
-    "          V-View A-About Q-Quit         "
+    "   V-View Y-Sync /-Find H-Help Q-Quit   "
   };
   unsigned char i;
   for(i = 0; i < MAIN_MENU_HEIGHT; i++) {
     size_t len = strlen(menu[i]);
-    gotoxy(center_x(len), screen_height - MAIN_MENU_HEIGHT + i);
-    cputs(menu[i]);
+    screen_goto(center_x(len), screen_height - MAIN_MENU_HEIGHT + i);
+    screen_puts(menu[i]);
   }
 }
 
 static void redraw(void)
 {
+  screen_begin_page();
   screen_clear();
   main_menu_draw();
   dir_panel_draw(current_dir_panel);
+  screen_end_page();
+}
+
+static void show_help(void)
+{
+  static const char *labels[HELP_LABEL_COUNT] = {
+    "Up/Down Move       Space Select",
+    "8 9 0 1 Device     R Reload dir",
+    "C Copy             N Rename",
+    "D Delete           Y Sync",
+    "L Load             S Save",
+    "F Free             V View",
+    "/ Find             . Find next",
+    "+ Select group     - Unselect group",
+    "* Invert selection = Select all",
+    "U Resume copying   P Prefetch dirs",
+    "G Grep files       RUN/STOP Stop job",
+    "A About            Q Quit"
+  };
+  help_dialog_set("Help", labels, HELP_LABEL_COUNT);
+  help_dialog_draw();
+  help_dialog_loop();
+}
+
+/*
+ * Advances the running job by one step. The directory panel is drawn again if the job changed its
+ * status, otherwise only the status line is drawn at most four times per second.
+ */
+static void step_job(void)
+{
+  unsigned char status = current_dir_panel->status;
+  clock_t now;
+  job_step();
+  if(current_dir_panel->status != status) {
+    dir_panel_draw(current_dir_panel);
+    return;
+  }
+  now = clock();
+  if(!job_is_running() || now - job_status_time >= PROGRESS_INTERVAL) {
+    job_status_time = now;
+    dir_panel_draw_status(current_dir_panel);
+  }
+}
+
+static void show_job_message(void)
+{
+  const char *title;
+  const char *msg = job_message(&title);
+  if(msg != NULL) {
+    message_dialog_set(title, msg);
+    message_dialog_draw();
+    message_dialog_loop();
+  }
+}
+
+static char check_device(const char *title)
+{
+  if(job_is_device_busy(current_dir_panel->device)) {
+    message_dialog_set(title, "Device is busy");
+    message_dialog_draw();
+    message_dialog_loop();
+    return 0;
+  }
+  return 1;
+}
+
+/*
+ * Changes the current directory panel. The directory is loaded by a prefetch job if the device is
+ * busy.
+ */
+static void change_dir_panel(unsigned char i)
+{
+  current_dir_panel = &dir_panels[i];
+  if(current_dir_panel->status == DIR_PANEL_STATUS_UNLOADED) {
+    if(!job_is_device_busy(current_dir_panel->device)) {
+      dir_panel_reload(current_dir_panel);
+      return;
+    }
+    job_add_prefetch(current_dir_panel);
+  }
+  dir_panel_draw(current_dir_panel);
+}
+
+static void prefetch_dirs(void)
+{
+  unsigned char i;
+  for(i = 0; i < DIR_PANEL_MAX; i++) {
+    if(dir_panels[i].status == DIR_PANEL_STATUS_UNLOADED) {
+      if(!job_add_prefetch(&dir_panels[i])) {
+        message_dialog_set("Error", "Out of memory");
+        message_dialog_draw();
+        message_dialog_loop();
+        return;
+      }
+    }
+  }
+  dir_panel_draw_status(current_dir_panel);
+}
+
+static void stop_job(void)
+{
+  if(!job_is_running()) return;
+  yes_no_dialog_set("Stop", "Stop job?");
+  yes_no_dialog_draw();
+  if(yes_no_dialog_loop()) {
+    job_stop();
+    dir_panel_draw(current_dir_panel);
+  }
 }
 
 static char check_file_types_for_copy(void)
@@ -61,8 +221,7 @@ static char check_file_types_for_copy(void)
   unsigned i;
   for(i = 0; i < current_dir_panel->selected_elem_index_count; i++) {
     unsigned j = current_dir_panel->selected_elem_indices[i];
-    unsigned char file_type = current_dir_panel->dir_list[j].entry.type;
-    if(file_type != _CBM_T_SEQ && file_type != _CBM_T_PRG && file_type != _CBM_T_USR) return 0;
+    if(!is_file_type_for_copy(dir_panel_elem(current_dir_panel, j)->entry.type)) return 0;
   }
   return 1;
 }
@@ -70,8 +229,7 @@ static char check_file_types_for_copy(void)
 static char check_file_type_for_load(void)
 {
   if(current_dir_panel->dir_list_length > 0) {
-    unsigned char file_type = current_dir_panel->dir_list[current_dir_panel->cursor_y].entry.type;
-    if(file_type != _CBM_T_SEQ && file_type != _CBM_T_PRG && file_type != _CBM_T_USR) return 0;
+    if(!is_file_type_for_copy(dir_panel_elem(current_dir_panel, current_dir_panel->cursor_y)->entry.type)) return 0;
   }
   return 1;
 }
@@ -90,24 +248,14 @@ static int str_to_file_type_for_copy(const char *s)
     return -2;
 }
 
-static char *file_type_to_str_for_copy(unsigned char file_type)
-{
-  switch(file_type) {
-  case _CBM_T_SEQ:
-    return "s";
-  case _CBM_T_USR:
-    return "u";
-  default:
-    return "p";
-  }
-}
-
-static char *file_type_to_str_for_copy2(int file_type, unsigned char default_file_type)
+static int str_to_yes_or_no(const char *s)
 {
-  if(file_type == -1)
-    return file_type_to_str_for_copy(default_file_type);
+  if(strcmp(s, "y") == 0 || strcmp(s, "yes") == 0)
+    return 1;
+  else if(strcmp(s, "n") == 0 || strcmp(s, "no") == 0 || *s == 0)
+    return 0;
   else
-    return file_type_to_str_for_copy(file_type);
+    return -1;
 }
 
 static char check_prefix_and_suffix_length(const char *prefix, const char *suffix)
@@ -117,44 +265,72 @@ static char check_prefix_and_suffix_length(const char *prefix, const char *suffi
   size_t suffix_len = strlen(suffix);
   for(i = 0; i < current_dir_panel->selected_elem_index_count; i++) {
     unsigned j = current_dir_panel->selected_elem_indices[i];
-    size_t name_len = strlen(current_dir_panel->dir_list[j].entry.name);
+    size_t name_len = strlen(dir_panel_elem(current_dir_panel, j)->entry.name);
     if(prefix_len + name_len + suffix_len > 16) return 0;
   }
   return 1;
 }
 
-static int rename_file(unsigned char device, const char *old_file_name, const char *new_file_name, const char **msg)
+/*
+ * Sets and draws the progress dialog with the progress of a transfer and the information about the
+ * transfer rate and the remaining time.
+ */
+static void start_transfer(const char *title, struct progress *progress, unsigned size_in_blocks)
 {
-  static char buf[16 + 1 + 16 + 2 + 1];
-  int res;
-  sprintf(buf, "r:%s=%s", new_file_name, old_file_name);
-  res = cmd_channel_write(device, buf, 1);
-  if(res == -1) return -1;
-  res = cmd_channel_read(device, msg, 0);
-  if(res == -1) return -1;
-  cmd_channel_close(device);
-  return res;
+  transfer_meter.progress = progress;
+  transfer_meter.size_in_blocks = size_in_blocks;
+  progress->count = (size_in_blocks != 0 ? 0 : PROGRESS_MAX);
+  transfer_info[0] = 0;
+  progress_dialog_set(title, progress, 1);
+  progress_dialog_set_info(transfer_info, TRANSFER_INFO_MAX);
+  progress_dialog_draw();
+  transfer_meter.start_time = clock();
+  transfer_meter.draw_time = transfer_meter.start_time;
 }
 
-static int delete_file(unsigned char device, const char *file_name, const char **msg)
+static void update_transfer(unsigned blocks, unsigned long bytes)
 {
-  static char buf[16 + 2 + 1];
-  int res;
-  sprintf(buf, "s:%s", file_name);
-  res = cmd_channel_write(device, buf, 1);
-  if(res == -1) return -1;
-  res = cmd_channel_read(device, msg, 0);
-  if(res == -1) return -1;
-  cmd_channel_close(device);
-  return res;
+  struct progress *progress = transfer_meter.progress;
+  clock_t now;
+  clock_t elapsed;
+  unsigned old_count;
+  now = clock();
+  if(now - transfer_meter.draw_time < PROGRESS_INTERVAL && blocks != transfer_meter.size_in_blocks) return;
+  transfer_meter.draw_time = now;
+  old_count = progress->count;
+  if(blocks < transfer_meter.size_in_blocks)
+    progress->count = ((unsigned long) blocks * PROGRESS_MAX) / transfer_meter.size_in_blocks;
+  else
+    progress->count = PROGRESS_MAX;
+  progress_dialog_update(0, old_count);
+  elapsed = now - transfer_meter.start_time;
+  if(elapsed != 0 && blocks != 0) {
+    unsigned long rate = (bytes * CLOCKS_PER_SEC) / elapsed;
+    unsigned long remaining = 0;
+    if(blocks < transfer_meter.size_in_blocks)
+      remaining = ((transfer_meter.size_in_blocks - blocks) * elapsed) / blocks / CLOCKS_PER_SEC;
+    if(remaining > REMAINING_TIME_MAX) remaining = REMAINING_TIME_MAX;
+    sprintf(transfer_info, "%5lu B/s %2lu:%02lu", (rate > 99999 ? 99999 : rate), remaining / 60, remaining % 60);
+    progress_dialog_draw_info();
+  }
 }
 
-static void reload_or_set_status_to_unloaded(unsigned char device)
+static void resume_copying(void)
 {
-  if(current_dir_panel->device == device)
-    dir_panel_reload(current_dir_panel);
-  else
-    dir_panel_set_status_to_unloaded(&dir_panels[device - 8]);
+  static char question[40];
+  unsigned file_count = job_stopped_file_count();
+  if(file_count == 0) {
+    message_dialog_set("Resume", "No stopped copying");
+    message_dialog_draw();
+    message_dialog_loop();
+    return;
+  }
+  sprintf(question, "Resume copying of %u files?", file_count);
+  yes_no_dialog_set("Resume", question);
+  yes_no_dialog_draw();
+  if(!yes_no_dialog_loop()) return;
+  job_resume();
+  dir_panel_draw_status(current_dir_panel);
 }
 
 static void copy_files(void)
@@ -164,8 +340,8 @@ static void copy_files(void)
   static char dst_suffix[17];
   static char dst_device_buf[17];
   static char dst_file_type_buf[17];
-  static char file_name_with_colon[18];
-  static struct input inputs_for_one_file[3] = {
+  static char verify_buf[17];
+  static struct input inputs_for_one_file[4] = {
     {
       "Dest device:",
       dst_device_buf,
@@ -180,9 +356,14 @@ static void copy_files(void)
       "Dest file type:",
       dst_file_type_buf,
       16
+    },
+    {
+      "Verify (y/n):",
+      verify_buf,
+      16
     }
   };
-  static struct input inputs_for_many_files[4] = {
+  static struct input inputs_for_many_files[5] = {
     {
       "Dest device:",
       dst_device_buf,
@@ -202,49 +383,38 @@ static void copy_files(void)
       "Dest file type:",
       dst_file_type_buf,
       16
-    }
-  };
-  static struct progress progresses[2] = {
-    {
-      file_name_with_colon,
-      0,
-      PROGRESS_MAX
     },
     {
-      "Copying files:",
-      0,
-      PROGRESS_MAX
+      "Verify (y/n):",
+      verify_buf,
+      16
     }
   };
-  static char src_cbm_file_name[16 + 1 + 3 + 1 + 1 + 1];
-  static char dst_cbm_file_name[16 + 1 + 3 + 1 + 1 + 1];
-  static char buf[BUFFER_SIZE];
   unsigned char dst_device;
   int dst_file_type;
+  int is_verify;
   char are_many_files;
   unsigned *selected_elem_indices;
   unsigned selected_elem_index_count;
+  struct job *job;
   unsigned i;
   selected_elem_indices = dir_panel_selected_elem_indices(current_dir_panel, &selected_elem_index_count);
   if(selected_elem_indices == NULL) {
     message_dialog_set("Error", "Out of memory");
     message_dialog_draw();
     message_dialog_loop();
-    redraw();
     return;
   }
   if(selected_elem_index_count == 0) {
     message_dialog_set("Copy", "No selected files");
     message_dialog_draw();
     message_dialog_loop();
-    redraw();
     return;
   }  
   if(!check_file_types_for_copy()) {
     message_dialog_set("Copy", "Not support for file type");
     message_dialog_draw();
     message_dialog_loop();
-    redraw();
     return;
   }
   are_many_files = (selected_elem_index_count > 1);
@@ -254,26 +424,21 @@ static void copy_files(void)
     dst_suffix[0] = 0;
   } else {
     unsigned i = selected_elem_indices[0];
-    strcpy(dst_file_name, current_dir_panel->dir_list[i].entry.name);
+    strcpy(dst_file_name, dir_panel_elem(current_dir_panel, i)->entry.name);
   }
   dst_file_type_buf[0] = 0;
   while(1) {
     if(are_many_files)
-      input_dialog_set("Copy", inputs_for_many_files, 4);
+      input_dialog_set("Copy", inputs_for_many_files, 5);
     else
-      input_dialog_set("Copy", inputs_for_one_file, 3);
+      input_dialog_set("Copy", inputs_for_one_file, 4);
     input_dialog_draw();
-    if(!input_dialog_loop()) {
-      redraw();
-      return;
-    }
-    redraw();
+    if(!input_dialog_loop()) return;
     dst_device = atoi(dst_device_buf);
     if(dst_device < 8 || dst_device > 11) {
       message_dialog_set("Field", "Incorrect dest device");
       message_dialog_draw();
       message_dialog_loop();
-      redraw();
       continue;
     }
     if(are_many_files) {
@@ -281,21 +446,18 @@ static void copy_files(void)
         message_dialog_set("Field", "Dest prefix or dest suffix is too long");
         message_dialog_draw();
         message_dialog_loop();
-        redraw();
         continue;
       }
       if(!check_file_name(dst_prefix)) {
         message_dialog_set("Field", "Incorrect dest prefix");
         message_dialog_draw();
         message_dialog_loop();
-        redraw();
         continue;
       }
       if(!check_file_name(dst_suffix)) {
         message_dialog_set("Field", "Incorrect dest suffix");
         message_dialog_draw();
         message_dialog_loop();
-        redraw();
         continue;
       }
     } else {
@@ -303,7 +465,6 @@ static void copy_files(void)
         message_dialog_set("Field", "Incorrect dest file name");
         message_dialog_draw();
         message_dialog_loop();
-        redraw();
         continue;
       }
     }
@@ -312,217 +473,408 @@ static void copy_files(void)
       message_dialog_set("Field", "Incorrect dest file type");
       message_dialog_draw();
       message_dialog_loop();
-      redraw();
+      continue;
+    }
+    is_verify = str_to_yes_or_no(verify_buf);
+    if(is_verify == -1) {
+      message_dialog_set("Field", "Incorrect verify");
+      message_dialog_draw();
+      message_dialog_loop();
       continue;
     }
     if(current_dir_panel->device == dst_device && 
       (are_many_files ?
         dst_prefix[0] == 0 && dst_suffix[0] == 0 :
-        strcmp(current_dir_panel->dir_list[selected_elem_indices[0]].entry.name, dst_file_name) == 0)) {
+        strcmp(dir_panel_elem(current_dir_panel, selected_elem_indices[0])->entry.name, dst_file_name) == 0)) {
       message_dialog_set("Field", "Can't copy to same files");
       message_dialog_draw();
       message_dialog_loop();
-      redraw();
       continue;
     }
     break;
   }
-  progresses[0].count = 0;
-  progresses[1].count = 0;
-  progress_dialog_set("Copying", progresses, 2);
+  job = job_new(JOB_TYPE_COPY, selected_elem_index_count);
+  if(job == NULL) {
+    message_dialog_set("Error", "Out of memory");
+    message_dialog_draw();
+    message_dialog_loop();
+    return;
+  }
   for(i = 0; i < selected_elem_index_count; i++) {
-    unsigned j = selected_elem_indices[i];
-    struct cbm_dirent *entry = &(current_dir_panel->dir_list[j].entry);
-    unsigned char src_device = current_dir_panel->device;
-    char *src_file_name = entry->name;
-    unsigned char src_file_type = entry->type;
-    unsigned size_in_blocks = entry->size;
-    unsigned char res;
-    unsigned char src_lfn = 14, dst_lfn = 15;
-    unsigned blocks;
-    int res2, res3;
-    const char *error;
-    char is_stop;
-    sprintf(file_name_with_colon, "%s:", src_file_name);
-    if(size_in_blocks != 0)
-      progresses[0].count = 0;
-    else
-      progresses[0].count = PROGRESS_MAX;
-    progress_dialog_draw();
-    sprintf(src_cbm_file_name, "%s,%s,r", src_file_name, file_type_to_str_for_copy(src_file_type));
-    if(are_many_files) {
-      dst_file_name[0] = 0;
-      strcat(dst_file_name, dst_prefix);
-      strcat(dst_file_name, src_file_name);
-      strcat(dst_file_name, dst_suffix);
+    job->entries[i] = dir_panel_elem(current_dir_panel, selected_elem_indices[i])->entry;
+  }
+  job->src_device = current_dir_panel->device;
+  job->dst_device = dst_device;
+  job->dst_file_type = dst_file_type;
+  job->is_verify = is_verify;
+  job->are_many_files = are_many_files;
+  if(are_many_files) {
+    strcpy(job->dst_prefix, dst_prefix);
+    strcpy(job->dst_suffix, dst_suffix);
+  } else
+    strcpy(job->dst_file_name, dst_file_name);
+  job_add(job);
+  dir_panel_draw_status(current_dir_panel);
+}
+
+/*
+ * A synchronization copies files that are missing or different in the destination directory. Files are
+ * compared by name, type and size in blocks. Both directories are merged by their sorted indices, so
+ * the synchronization only copies and deletes files that differ.
+ */
+static void sync_dirs(void)
+{
+  static char dst_device_buf[17];
+  static char delete_buf[17];
+  static char verify_buf[17];
+  static char question[40];
+  static struct input inputs[3] = {
+    {
+      "Dest device:",
+      dst_device_buf,
+      16
+    },
+    {
+      "Delete extras (y/n):",
+      delete_buf,
+      16
+    },
+    {
+      "Verify (y/n):",
+      verify_buf,
+      16
     }
-    sprintf(dst_cbm_file_name, "%s,%s,w", dst_file_name,  file_type_to_str_for_copy2(dst_file_type, src_file_type));
-    res = cbm_open(src_lfn, src_device, 0, src_cbm_file_name);
-    if(res != 0) {
-      redraw();
-      message_dialog_set("Error", _stroserror(_oserror));
-      cbm_close(src_lfn);
+  };
+  struct dir_panel *dst_dir_panel;
+  unsigned char dst_device;
+  int is_delete;
+  int is_verify;
+  unsigned *src_sorted_elem_indices;
+  unsigned *dst_sorted_elem_indices;
+  unsigned *copied_elem_indices;
+  unsigned *deleted_elem_indices;
+  unsigned copied_elem_index_count, deleted_elem_index_count;
+  struct job *copy_job, *delete_job;
+  unsigned i, j;
+  if(current_dir_panel->status != DIR_PANEL_STATUS_LOADED) {
+    message_dialog_set("Sync", "No loaded directory");
+    message_dialog_draw();
+    message_dialog_loop();
+    return;
+  }
+  if(dst_device_buf[0] == 0)
+    sprintf(dst_device_buf, "%u", (unsigned) (8 + ((current_dir_panel->device - 8 + 1) & 3)));
+  while(1) {
+    input_dialog_set("Sync", inputs, 3);
+    input_dialog_draw();
+    if(!input_dialog_loop()) return;
+    dst_device = atoi(dst_device_buf);
+    if(dst_device < 8 || dst_device > 11) {
+      message_dialog_set("Field", "Incorrect dest device");
       message_dialog_draw();
       message_dialog_loop();
-      break;
+      continue;
     }
-    res2 = cmd_channel_read(src_device, &error, 1);
-    if(res2 == -1) {
-      redraw();
-      message_dialog_set("Error", _stroserror(_oserror));
-      cbm_close(src_lfn);
+    if(current_dir_panel->device == dst_device) {
+      message_dialog_set("Field", "Can't sync to same device");
       message_dialog_draw();
       message_dialog_loop();
-      break;
-    } else if(res2 > 0) {
-      redraw();
-      message_dialog_set("Error", error);
-      cbm_close(src_lfn);
-      cmd_channel_close(src_device);
-      message_dialog_draw();
-      message_dialog_loop();
-      break;
+      continue;
     }
-    res2 = delete_file(dst_device, dst_file_name, &error);
-    if(res2 == -1) {
-      redraw();
-      message_dialog_set("Error", _stroserror(_oserror));
-      cbm_close(src_lfn);
-      cmd_channel_close(src_device);
+    is_delete = str_to_yes_or_no(delete_buf);
+    if(is_delete == -1) {
+      message_dialog_set("Field", "Incorrect delete extras");
       message_dialog_draw();
       message_dialog_loop();
-      break;
+      continue;
     }
-    res = cbm_open(dst_lfn, dst_device, 1, dst_cbm_file_name);
-    if(res != 0) {
-      redraw();
-      message_dialog_set("Error", _stroserror(_oserror));
-      cbm_close(dst_lfn);
-      cbm_close(src_lfn);
-      cmd_channel_close(src_device);
+    is_verify = str_to_yes_or_no(verify_buf);
+    if(is_verify == -1) {
+      message_dialog_set("Field", "Incorrect verify");
       message_dialog_draw();
       message_dialog_loop();
-      break;
+      continue;
     }
-    res2 = cmd_channel_read(dst_device, &error, 1);
-    if(res2 == -1) {
-      redraw();
-      message_dialog_set("Error", _stroserror(_oserror));
-      cbm_close(dst_lfn);
-      cbm_close(src_lfn);
-      cmd_channel_close(src_device);
-      message_dialog_draw();
-      message_dialog_loop();
-      break;
-    } else if(res2 > 0) {
-      redraw();
-      message_dialog_set("Error", error);
-      cbm_close(dst_lfn);
-      cmd_channel_close(dst_device);
-      cbm_close(src_lfn);
-      cmd_channel_close(src_device);
+    if(job_is_device_busy(current_dir_panel->device) || job_is_device_busy(dst_device)) {
+      message_dialog_set("Sync", "Device is busy");
       message_dialog_draw();
       message_dialog_loop();
-      break;
+      return;
     }
-    is_stop = 0;
-    blocks = 0;
-    while(1) {
-      res2 = cbm_read(src_lfn, buf, BUFFER_SIZE);
-      if(res2 == -1) {
-        redraw();
-        message_dialog_set("Error", _stroserror(_oserror));
-        cbm_close(dst_lfn);
-        cmd_channel_close(dst_device);
-        cbm_close(src_lfn);
-        cmd_channel_close(src_device);
-        message_dialog_draw();
-        message_dialog_loop();
-        is_stop = 1;
-        break;
-      } else if(res2 == 0)
-        break;
-      res3 = cbm_write(dst_lfn, buf, res2);
-      if(res3 == -1) {
-        redraw();
-        message_dialog_set("Error", _stroserror(_oserror));
-        cbm_close(dst_lfn);
-        cmd_channel_close(dst_device);
-        cbm_close(src_lfn);
-        cmd_channel_close(src_device);
-        message_dialog_draw();
-        message_dialog_loop();
-        is_stop = 1;
-        break;
+    break;
+  }
+  dst_dir_panel = &dir_panels[dst_device - 8];
+  /* The loaded directory is still valid because the directory panel is unloaded after changes. */
+  if(dst_dir_panel->status != DIR_PANEL_STATUS_LOADED) {
+    dir_panel_reload(dst_dir_panel);
+    redraw();
+  }
+  if(dst_dir_panel->status != DIR_PANEL_STATUS_LOADED) {
+    message_dialog_set("Error", dst_dir_panel->error);
+    message_dialog_draw();
+    message_dialog_loop();
+    return;
+  }
+  src_sorted_elem_indices = dir_panel_sorted_elem_indices(current_dir_panel);
+  dst_sorted_elem_indices = dir_panel_sorted_elem_indices(dst_dir_panel);
+  copied_elem_indices = malloc(sizeof(unsigned) * (current_dir_panel->dir_list_length + 1));
+  deleted_elem_indices = malloc(sizeof(unsigned) * (dst_dir_panel->dir_list_length + 1));
+  if(src_sorted_elem_indices == NULL || dst_sorted_elem_indices == NULL || copied_elem_indices == NULL || deleted_elem_indices == NULL) {
+    if(copied_elem_indices != NULL) free(copied_elem_indices);
+    if(deleted_elem_indices != NULL) free(deleted_elem_indices);
+    message_dialog_set("Error", "Out of memory");
+    message_dialog_draw();
+    message_dialog_loop();
+    return;
+  }
+  copied_elem_index_count = 0;
+  deleted_elem_index_count = 0;
+  i = 0;
+  j = 0;
+  while(i < current_dir_panel->dir_list_length || j < dst_dir_panel->dir_list_length) {
+    struct cbm_dirent *src_entry = NULL;
+    struct cbm_dirent *dst_entry = NULL;
+    int res;
+    if(i < current_dir_panel->dir_list_length)
+      src_entry = &(dir_panel_elem(current_dir_panel, src_sorted_elem_indices[i])->entry);
+    if(j < dst_dir_panel->dir_list_length)
+      dst_entry = &(dir_panel_elem(dst_dir_panel, dst_sorted_elem_indices[j])->entry);
+    if(src_entry == NULL)
+      res = 1;
+    else if(dst_entry == NULL)
+      res = -1;
+    else
+      res = strcmp(src_entry->name, dst_entry->name);
+    if(res < 0) {
+      if(is_file_type_for_copy(src_entry->type)) {
+        copied_elem_indices[copied_elem_index_count] = src_sorted_elem_indices[i];
+        copied_elem_index_count++;
       }
-      blocks++;
-      if(size_in_blocks != 0)
-        progresses[0].count = (((unsigned long) blocks) * PROGRESS_MAX) / size_in_blocks;
-      else
-        progresses[0].count = PROGRESS_MAX;
-      progresses[0].count = umin(PROGRESS_MAX, progresses[0].count);
-      progress_dialog_draw();
+      i++;
+    } else if(res > 0) {
+      /*
+       * Only files that can be created by a synchronization are deleted. A file name with a wildcard
+       * or a separator of the scratch command would scratch other files, so this file isn't deleted.
+       */
+      if(is_delete && is_file_type_for_copy(dst_entry->type) && strpbrk(dst_entry->name, "*?,:") == NULL) {
+        deleted_elem_indices[deleted_elem_index_count] = dst_sorted_elem_indices[j];
+        deleted_elem_index_count++;
+      }
+      j++;
+    } else {
+      if(is_file_type_for_copy(src_entry->type) && (src_entry->type != dst_entry->type || src_entry->size != dst_entry->size)) {
+        copied_elem_indices[copied_elem_index_count] = src_sorted_elem_indices[i];
+        copied_elem_index_count++;
+      }
+      i++;
+      j++;
     }
-    if(is_stop) break;
-    cbm_close(dst_lfn);
-    cmd_channel_close(dst_device);
-    cbm_close(src_lfn);
-    cmd_channel_close(src_device);
-    progresses[1].count = (((unsigned long) (i + 1)) * PROGRESS_MAX) / selected_elem_index_count;
-    progress_dialog_draw();
   }
-  redraw();
-  reload_or_set_status_to_unloaded(dst_device);
+  if(copied_elem_index_count == 0 && deleted_elem_index_count == 0) {
+    free(copied_elem_indices);
+    free(deleted_elem_indices);
+    message_dialog_set("Sync", "Directories are synced");
+    message_dialog_draw();
+    message_dialog_loop();
+    return;
+  }
+  sprintf(question, "Copy %u and delete %u files?", copied_elem_index_count, deleted_elem_index_count);
+  yes_no_dialog_set("Sync", question);
+  yes_no_dialog_draw();
+  if(!yes_no_dialog_loop()) {
+    free(copied_elem_indices);
+    free(deleted_elem_indices);
+    return;
+  }
+  copy_job = NULL;
+  delete_job = NULL;
+  if(copied_elem_index_count > 0) copy_job = job_new(JOB_TYPE_COPY, copied_elem_index_count);
+  if(deleted_elem_index_count > 0) delete_job = job_new(JOB_TYPE_DELETE, deleted_elem_index_count);
+  if((copied_elem_index_count > 0 && copy_job == NULL) || (deleted_elem_index_count > 0 && delete_job == NULL)) {
+    if(copy_job != NULL) job_free(copy_job);
+    if(delete_job != NULL) job_free(delete_job);
+    free(copied_elem_indices);
+    free(deleted_elem_indices);
+    message_dialog_set("Error", "Out of memory");
+    message_dialog_draw();
+    message_dialog_loop();
+    return;
+  }
+  if(copy_job != NULL) {
+    for(i = 0; i < copied_elem_index_count; i++) {
+      copy_job->entries[i] = dir_panel_elem(current_dir_panel, copied_elem_indices[i])->entry;
+    }
+    copy_job->src_device = current_dir_panel->device;
+    copy_job->dst_device = dst_device;
+    copy_job->is_verify = is_verify;
+    copy_job->are_many_files = 1;
+    job_add(copy_job);
+  }
+  if(delete_job != NULL) {
+    for(i = 0; i < deleted_elem_index_count; i++) {
+      delete_job->entries[i] = dir_panel_elem(dst_dir_panel, deleted_elem_indices[i])->entry;
+    }
+    delete_job->src_device = dst_device;
+    job_add(delete_job);
+  }
+  free(copied_elem_indices);
+  free(deleted_elem_indices);
+  dir_panel_draw_status(current_dir_panel);
 }
 
-static void rename_files(void)
+/*
+ * Finds the next file in the loaded directories. Files are found by sorted indices of the directory
+ * panels without reading the directories from devices. The pattern without '*' matches file names
+ * with the pattern as prefix.
+ */
+static void find_next_file(void)
 {
-  static char new_file_name[17];
-  static char new_prefix[17];
-  static char new_suffix[17];
-  static struct input inputs_for_one_file[1] = {
+  unsigned char start_dir_panel_index;
+  unsigned start_sorted_index;
+  unsigned char i;
+  if(has_found_file) {
+    start_dir_panel_index = found_dir_panel_index;
+    start_sorted_index = found_sorted_index + 1;
+  } else {
+    start_dir_panel_index = current_dir_panel - dir_panels;
+    start_sorted_index = 0;
+  }
+  for(i = 0; i <= DIR_PANEL_MAX; i++) {
+    unsigned char j = (start_dir_panel_index + i) & (DIR_PANEL_MAX - 1);
+    struct dir_panel *dir_panel = &dir_panels[j];
+    unsigned sorted_index = (i == 0 ? start_sorted_index : 0);
+    int res;
+    if(dir_panel->status != DIR_PANEL_STATUS_LOADED) continue;
+    res = dir_panel_find(dir_panel, find_pattern, &sorted_index);
+    if(res == -1) {
+      message_dialog_set("Error", "Out of memory");
+      message_dialog_draw();
+      message_dialog_loop();
+      return;
+    } else if(res == 1) {
+      has_found_file = 1;
+      found_dir_panel_index = j;
+      found_sorted_index = sorted_index;
+      current_dir_panel = dir_panel;
+      dir_panel_set_cursor(dir_panel, dir_panel->sorted_elem_indices[sorted_index]);
+      return;
+    }
+  }
+  has_found_file = 0;
+  message_dialog_set("Find", "File not found");
+  message_dialog_draw();
+  message_dialog_loop();
+}
+
+static void find_file(void)
+{
+  static char pattern[17];
+  static struct input inputs[1] = {
     {
-      "New file name:",
-      new_file_name,
-      16
+      "File name pattern:",
+      pattern,
+      15
     }
   };
-  static struct input inputs_for_many_files[2] = {
+  input_dialog_set("Find", inputs, 1);
+  input_dialog_draw();
+  if(!input_dialog_loop()) return;
+  strcpy(find_pattern, pattern);
+  if(strchr(find_pattern, '*') == NULL) strcat(find_pattern, "*");
+  has_found_file = 0;
+  find_next_file();
+}
+
+static int str_to_file_type_for_selection(const char *s)
+{
+  if(strcmp(s, "r") == 0 || strcmp(s, "rel") == 0)
+    return _CBM_T_REL;
+  else
+    return str_to_file_type_for_copy(s);
+}
+
+static void select_group(char is_selected)
+{
+  static char pattern[17];
+  static char file_type_buf[17];
+  static struct input inputs[2] = {
     {
-      "New prefix:",
-      new_prefix,
+      "File name pattern:",
+      pattern,
       16
     },
     {
-      "New suffix:",
-      new_suffix,
+      "File type:",
+      file_type_buf,
       16
     }
   };
-  static struct progress progresses[1] = {
+  const char *title = (is_selected ? "Select" : "Unselect");
+  int file_type;
+  if(current_dir_panel->dir_list_length == 0) return;
+  if(pattern[0] == 0) strcpy(pattern, "*");
+  while(1) {
+    input_dialog_set(title, inputs, 2);
+    input_dialog_draw();
+    if(!input_dialog_loop()) return;
+    if(pattern[0] == 0) {
+      message_dialog_set("Field", "Incorrect file name pattern");
+      message_dialog_draw();
+      message_dialog_loop();
+      continue;
+    }
+    file_type = str_to_file_type_for_selection(file_type_buf);
+    if(file_type == -2) {
+      message_dialog_set("Field", "Incorrect file type");
+      message_dialog_draw();
+      message_dialog_loop();
+      continue;
+    }
+    break;
+  }
+  dir_panel_select_by_pattern(current_dir_panel, pattern, file_type, is_selected);
+}
+
+static void rename_files(void)
+{
+  static char new_file_name[17];
+  static char new_prefix[17];
+  static char new_suffix[17];
+  static struct input inputs_for_one_file[1] = {
     {
-      "Renaming files:",
-      0,
-      PROGRESS_MAX
+      "New file name:",
+      new_file_name,
+      16
+    }
+  };
+  static struct input inputs_for_many_files[2] = {
+    {
+      "New prefix:",
+      new_prefix,
+      16
+    },
+    {
+      "New suffix:",
+      new_suffix,
+      16
     }
   };
   char are_many_files;
   unsigned *selected_elem_indices;
   unsigned selected_elem_index_count;
+  struct job *job;
   unsigned i;
   selected_elem_indices = dir_panel_selected_elem_indices(current_dir_panel, &selected_elem_index_count);
   if(selected_elem_indices == NULL) {
     message_dialog_set("Error", "Out of memory");
     message_dialog_draw();
     message_dialog_loop();
-    redraw();
     return;
   }
   if(selected_elem_index_count == 0) {
     message_dialog_set("Rename", "No selected files");
     message_dialog_draw();
     message_dialog_loop();
-    redraw();
     return;
   }  
   are_many_files = (selected_elem_index_count > 1);
@@ -531,7 +883,7 @@ static void rename_files(void)
     new_suffix[0] = 0;
   } else {
     unsigned i = selected_elem_indices[0];
-    strcpy(new_file_name, current_dir_panel->dir_list[i].entry.name);
+    strcpy(new_file_name, dir_panel_elem(current_dir_panel, i)->entry.name);
   }
   while(1) {
     if(are_many_files)
@@ -539,31 +891,24 @@ static void rename_files(void)
     else
       input_dialog_set("Rename", inputs_for_one_file, 1);
     input_dialog_draw();
-    if(!input_dialog_loop()) {
-      redraw();
-      return;
-    }
-    redraw();
+    if(!input_dialog_loop()) return;
     if(are_many_files) {
       if(!check_prefix_and_suffix_length(new_prefix, new_suffix)) {
         message_dialog_set("Field", "New prefix or new suffix is too long");
         message_dialog_draw();
         message_dialog_loop();
-        redraw();
         continue;
       }
       if(!check_file_name(new_prefix)) {
         message_dialog_set("Field", "Incorrect new prefix");
         message_dialog_draw();
         message_dialog_loop();
-        redraw();
         continue;
       }
       if(!check_file_name(new_suffix)) {
         message_dialog_set("Field", "Incorrect new suffix");
         message_dialog_draw();
         message_dialog_loop();
-        redraw();
         continue;
       }
     } else {
@@ -571,83 +916,59 @@ static void rename_files(void)
         message_dialog_set("Field", "Incorrect new file name");
         message_dialog_draw();
         message_dialog_loop();
-        redraw();
         continue;
       }
     }
     if(are_many_files ?
       new_prefix[0] == 0 && new_suffix[0] == 0 :
-      strcmp(current_dir_panel->dir_list[selected_elem_indices[0]].entry.name, new_file_name) == 0) {
+      strcmp(dir_panel_elem(current_dir_panel, selected_elem_indices[0])->entry.name, new_file_name) == 0) {
       message_dialog_set("Field", "Can't rename to same file names");
       message_dialog_draw();
       message_dialog_loop();
-      redraw();
       continue;
     }
     break;
   }
-  progresses[0].count = 0;
-  progress_dialog_set("Raneming", progresses, 1);
-  progress_dialog_draw();
+  job = job_new(JOB_TYPE_RENAME, selected_elem_index_count);
+  if(job == NULL) {
+    message_dialog_set("Error", "Out of memory");
+    message_dialog_draw();
+    message_dialog_loop();
+    return;
+  }
   for(i = 0; i < selected_elem_index_count; i++) {
-    unsigned j = selected_elem_indices[i];
-    unsigned char device = current_dir_panel->device;
-    char *old_file_name = current_dir_panel->dir_list[j].entry.name;
-    int res;
-    const char *error;
-    if(are_many_files) {
-      new_file_name[0] = 0;
-      strcat(new_file_name, new_prefix);
-      strcat(new_file_name, old_file_name);
-      strcat(new_file_name, new_suffix);
-    }
-    res = rename_file(device, old_file_name, new_file_name, &error);
-    if(res == -1) {
-      redraw();
-      message_dialog_set("Error", _stroserror(_oserror));
-      message_dialog_draw();
-      message_dialog_loop();
-      break;
-    } else if(res > 0) {
-      redraw();
-      message_dialog_set("Error", error);
-      message_dialog_draw();
-      message_dialog_loop();
-      break;
-    }
-    progresses[0].count = (((unsigned long) (i + 1)) * PROGRESS_MAX) / selected_elem_index_count;
-    progress_dialog_draw();
+    job->entries[i] = dir_panel_elem(current_dir_panel, selected_elem_indices[i])->entry;
   }
-  redraw();
-  dir_panel_reload(current_dir_panel);
+  job->src_device = current_dir_panel->device;
+  job->are_many_files = are_many_files;
+  if(are_many_files) {
+    strcpy(job->dst_prefix, new_prefix);
+    strcpy(job->dst_suffix, new_suffix);
+  } else
+    strcpy(job->dst_file_name, new_file_name);
+  job_add(job);
+  dir_panel_draw_status(current_dir_panel);
 }
 
 void delete_files(void)
 {
-  static struct progress progresses[1] = {
-    {
-      "Deleting files:",
-      0,
-      PROGRESS_MAX
-    }
-  };
   char are_many_files;
   unsigned *selected_elem_indices;
   unsigned selected_elem_index_count;
+  const char *selection_pattern;
+  struct job *job;
   unsigned i;
   selected_elem_indices = dir_panel_selected_elem_indices(current_dir_panel, &selected_elem_index_count);
   if(selected_elem_indices == NULL) {
     message_dialog_set("Error", "Out of memory");
     message_dialog_draw();
     message_dialog_loop();
-    redraw();
     return;
   }
   if(selected_elem_index_count == 0) {
     message_dialog_set("Delete", "No selected files");
     message_dialog_draw();
     message_dialog_loop();
-    redraw();
     return;
   }  
   are_many_files = (selected_elem_index_count > 1);
@@ -656,42 +977,45 @@ void delete_files(void)
   else
     yes_no_dialog_set("Delete", "Delete file?");
   yes_no_dialog_draw();
-  if(!yes_no_dialog_loop()) {
-    redraw();
+  if(!yes_no_dialog_loop()) return;
+  job = job_new(JOB_TYPE_DELETE, selected_elem_index_count);
+  if(job == NULL) {
+    message_dialog_set("Error", "Out of memory");
+    message_dialog_draw();
+    message_dialog_loop();
     return;
   }
-  redraw();
-  progresses[0].count = 0;
-  progress_dialog_set("Deleting", progresses, 1);
-  progress_dialog_draw();
   for(i = 0; i < selected_elem_index_count; i++) {
-    unsigned j = selected_elem_indices[i];
-    unsigned char device = current_dir_panel->device;
-    char *file_name = current_dir_panel->dir_list[j].entry.name;
-    int res;
-    const char *error;
-    res = delete_file(device, file_name, &error);
-    if(res == -1) {
-      redraw();
-      message_dialog_set("Error", _stroserror(_oserror));
-      message_dialog_draw();
-      message_dialog_loop();
-      break;
-    } else if(res > 0) {
-      redraw();
-      message_dialog_set("Error", error);
-      message_dialog_draw();
-      message_dialog_loop();
-      break;
-    }
-    progresses[0].count = (((unsigned long) (i + 1)) * PROGRESS_MAX) / selected_elem_index_count;
-    progress_dialog_draw();
+    job->entries[i] = dir_panel_elem(current_dir_panel, selected_elem_indices[i])->entry;
   }
-  redraw();
-  dir_panel_reload(current_dir_panel);  
+  job->src_device = current_dir_panel->device;
+  selection_pattern = dir_panel_selection_pattern(current_dir_panel);
+  if(selection_pattern != NULL) {
+    job->has_pattern = 1;
+    strcpy(job->pattern, selection_pattern);
+  }
+  job_add(job);
+  dir_panel_draw_status(current_dir_panel);
 }
 
-static char load_file(const char *title, struct file *file, struct file_ext *file_ext)
+static char check_file_for_load(const char *title)
+{
+  if(current_dir_panel->dir_list_length == 0) {
+    message_dialog_set(title, "No indicated file");
+    message_dialog_draw();
+    message_dialog_loop();
+    return 0;
+  }
+  if(!check_file_type_for_load()) {
+    message_dialog_set(title, "Not support for file type");
+    message_dialog_draw();
+    message_dialog_loop();
+    return 0;
+  }
+  return 1;
+}
+
+static char load_file(const char *title, struct chunked_file *file, struct file_ext *file_ext)
 {
   static char file_name_with_colon[18];
   static struct progress progresses[1] = {
@@ -702,140 +1026,98 @@ static char load_file(const char *title, struct file *file, struct file_ext *fil
     }
   };
   static char cbm_file_name[16 + 1 + 3 + 1 + 1 + 1];
+  static char buf[BUFFER_SIZE];
   struct cbm_dirent *entry;
   unsigned char device;
   const char *file_name;
   unsigned char file_type;
   unsigned size_in_blocks;
-  unsigned bytes, blocks;
+  unsigned long bytes;
+  unsigned blocks;
   unsigned char lfn = 14;
   unsigned char res;
   int res2;
   const char *error;
   unsigned i;
-  size_t capacity;
-  if(current_dir_panel->dir_list_length == 0) {
-    message_dialog_set(title, "No indicated file");
-    message_dialog_draw();
-    message_dialog_loop();
-    redraw();
-    return 0;
-  }
+  if(!check_file_for_load(title)) return 0;
   i = current_dir_panel->cursor_y;
-  if(!check_file_type_for_load()) {
-    message_dialog_set(title, "Not support for file type");
-    message_dialog_draw();
-    message_dialog_loop();
-    redraw();
-    return 0;
-  }
-  entry = &(current_dir_panel->dir_list[i].entry);
+  entry = &(dir_panel_elem(current_dir_panel, i)->entry);
   device = current_dir_panel->device;
   file_name = entry->name;
   file_type = entry->type;
   size_in_blocks = entry->size;
-  if(size_in_blocks > 254) {
+  if((unsigned long) size_in_blocks * DISK_BLOCK_DATA_SIZE > chunked_file_capacity(file)) {
     message_dialog_set("Error", "File is too big");
     message_dialog_draw();
     message_dialog_loop();
-    redraw();
     return 0;
   }
-  file_free(file);
-  capacity = (size_in_blocks + 1) * BUFFER_SIZE;
-  file->content = malloc(capacity);
-  if(file->content == NULL) {
-    message_dialog_set("Error", "Out of memory");
-    message_dialog_draw();
-    message_dialog_loop();
-    redraw();
-    return 0;
-  }
-  progress_dialog_set("Loading", progresses, 1);
+  chunked_file_free(file);
   sprintf(file_name_with_colon, "%s:", file_name);
-  if(size_in_blocks != 0)
-    progresses[0].count = 0;
-  else
-    progresses[0].count = PROGRESS_MAX;
-  progress_dialog_draw();
+  start_transfer("Loading", &(progresses[0]), size_in_blocks);
   sprintf(cbm_file_name, "%s,%s,r", file_name, file_type_to_str_for_copy(file_type));
   res = cbm_open(lfn, device, 0, cbm_file_name);
   if(res != 0) {
-    redraw();
+    progress_dialog_close();
     message_dialog_set("Error", _stroserror(_oserror));
     cbm_close(lfn);
-    file_free(file);
+    chunked_file_free(file);
     message_dialog_draw();
     message_dialog_loop();
-    redraw();
     return 0;
   }
   res2 = cmd_channel_read(device, &error, 1);
   if(res2 == -1) {
-    redraw();
+    progress_dialog_close();
     message_dialog_set("Error", _stroserror(_oserror));
     cbm_close(lfn);
-    file_free(file);
+    chunked_file_free(file);
     message_dialog_draw();
     message_dialog_loop();
-    redraw();
     return 0;
   } else if(res2 > 0) {
-    redraw();
+    progress_dialog_close();
     message_dialog_set("Error", error);
     cbm_close(lfn);
-    file_free(file);
+    chunked_file_free(file);
     cmd_channel_close(device);
     message_dialog_draw();
     message_dialog_loop();
-    redraw();
     return 0;
   }
   bytes = 0;
   blocks = 0;
   while(1) {
-    if(bytes + BUFFER_SIZE > capacity) {
-      char *old_content = file->content;
-      capacity += BUFFER_SIZE;
-      file->content = realloc(old_content, capacity);
-      if(file->content == NULL) {
-        redraw();
-        message_dialog_set("Error", "Out of memory");
-        free(old_content);
-        cbm_close(lfn);
-        cmd_channel_close(device);
-        message_dialog_draw();
-        message_dialog_loop();
-        redraw();
-        return 0;
-      }
-    }
-    res2 = cbm_read(lfn, file->content + bytes, BUFFER_SIZE);
+    res2 = cbm_read(lfn, buf, BUFFER_SIZE);
     if(res2 == -1) {
-      redraw();
+      progress_dialog_close();
       message_dialog_set("Error", _stroserror(_oserror));
       cbm_close(lfn);
       cmd_channel_close(device);
-      file_free(file);
+      chunked_file_free(file);
       message_dialog_draw();
       message_dialog_loop();
-      redraw();
       return 0;
     } else if(res2 == 0)
       break;
+    if(!chunked_file_append(file, buf, res2)) {
+      progress_dialog_close();
+      message_dialog_set("Error", "Out of memory");
+      cbm_close(lfn);
+      cmd_channel_close(device);
+      chunked_file_free(file);
+      message_dialog_draw();
+      message_dialog_loop();
+      return 0;
+    }
     bytes += res2;
     blocks++;
-    if(size_in_blocks != 0)
-      progresses[0].count = (((unsigned long) blocks) * PROGRESS_MAX) / size_in_blocks;
-    else
-      progresses[0].count = PROGRESS_MAX;
-    progresses[0].count = umin(PROGRESS_MAX, progresses[0].count);
-    progress_dialog_draw();
+    update_transfer(blocks, bytes);
   }
   cbm_close(lfn);
   cmd_channel_close(device);
-  redraw();
-  file->size = bytes;
+  progress_dialog_close();
+  file->is_loaded = 1;
   if(file_ext != NULL) {
     strcpy(file_ext->name, file_name);
     file_ext->size_in_blocks = size_in_blocks;
@@ -844,6 +1126,374 @@ static char load_file(const char *title, struct file *file, struct file_ext *fil
   return 1;
 }
 
+/*
+ * Prepares viewing the file that doesn't fit in memory. The file is read once to make the line
+ * checkpoints of its blocks, and then only a window of its blocks is kept in memory.
+ */
+static char load_file_window(unsigned char device, const struct cbm_dirent *entry)
+{
+  static char file_name_with_colon[18];
+  static struct progress progresses[1] = {
+    {
+      file_name_with_colon,
+      0,
+      PROGRESS_MAX
+    }
+  };
+  static char cbm_file_name[16 + 1 + 3 + 1 + 1 + 1];
+  unsigned char lfn = 14;
+  unsigned long bytes;
+  unsigned blocks;
+  unsigned lines;
+  unsigned line_char_count;
+  unsigned capacity_in_blocks;
+  int res2;
+  const char *error;
+  file_free(&view_file);
+  file_window_free(&view_window);
+  view_window.device = device;
+  strcpy(view_window.name, entry->name);
+  view_window.type = entry->type;
+  /* A 256-byte block holds more data than a disk block, so the block count is enough. */
+  view_window.block_count = entry->size;
+  view_window.line_checkpoints = malloc(sizeof(unsigned) * (entry->size + 1));
+  capacity_in_blocks = umin(VIEW_WINDOW_MAX_BLOCKS, umax(entry->size, 1));
+  while(1) {
+    view_file.content = malloc(capacity_in_blocks * BUFFER_SIZE);
+    if(view_file.content != NULL || capacity_in_blocks <= VIEW_WINDOW_MIN_BLOCKS) break;
+    capacity_in_blocks /= 2;
+  }
+  if(view_window.line_checkpoints == NULL || view_file.content == NULL) {
+    message_dialog_set("Error", "Out of memory");
+    file_free(&view_file);
+    file_window_free(&view_window);
+    message_dialog_draw();
+    message_dialog_loop();
+    return 0;
+  }
+  view_window.capacity_in_blocks = capacity_in_blocks;
+  sprintf(file_name_with_colon, "%s:", entry->name);
+  start_transfer("Scanning", &(progresses[0]), entry->size);
+  sprintf(cbm_file_name, "%s,%s,r", entry->name, file_type_to_str_for_copy(entry->type));
+  if(cbm_open(lfn, view_window.device, 0, cbm_file_name) != 0) {
+    progress_dialog_close();
+    message_dialog_set("Error", _stroserror(_oserror));
+    cbm_close(lfn);
+    file_free(&view_file);
+    file_window_free(&view_window);
+    message_dialog_draw();
+    message_dialog_loop();
+    return 0;
+  }
+  res2 = cmd_channel_read(view_window.device, &error, 1);
+  if(res2 != 0) {
+    progress_dialog_close();
+    message_dialog_set("Error", res2 == -1 ? _stroserror(_oserror) : error);
+    cbm_close(lfn);
+    if(res2 > 0) cmd_channel_close(view_window.device);
+    file_free(&view_file);
+    file_window_free(&view_window);
+    message_dialog_draw();
+    message_dialog_loop();
+    return 0;
+  }
+  bytes = 0;
+  blocks = 0;
+  lines = 0;
+  line_char_count = 0;
+  view_window.max_line_char_count = 0;
+  view_window.reu_addr = REU_LOADED_FILE_ADDR + loaded_file.reu_size;
+  view_window.is_in_reu = (view_window.reu_addr + (unsigned long) entry->size * BUFFER_SIZE <= reu_size());
+  while(blocks < view_window.block_count) {
+    char *s;
+    char *end;
+    res2 = cbm_read(lfn, view_file.content, BUFFER_SIZE);
+    if(res2 == -1) {
+      progress_dialog_close();
+      message_dialog_set("Error", _stroserror(_oserror));
+      cbm_close(lfn);
+      cmd_channel_close(view_window.device);
+      file_free(&view_file);
+      file_window_free(&view_window);
+      message_dialog_draw();
+      message_dialog_loop();
+      return 0;
+    } else if(res2 == 0)
+      break;
+    if(view_window.is_in_reu)
+      reu_stash(view_window.reu_addr + (unsigned long) blocks * BUFFER_SIZE, view_file.content, res2);
+    view_window.line_checkpoints[blocks] = lines;
+    end = view_file.content + res2;
+    for(s = view_file.content; s < end; s++) {
+      if(*s == '\n') {
+        lines++;
+        view_window.max_line_char_count = umax(view_window.max_line_char_count, line_char_count);
+        line_char_count = 0;
+      } else
+        line_char_count++;
+    }
+    bytes += res2;
+    blocks++;
+    update_transfer(blocks, bytes);
+  }
+  cbm_close(lfn);
+  cmd_channel_close(view_window.device);
+  progress_dialog_close();
+  view_window.max_line_char_count = umax(view_window.max_line_char_count, line_char_count);
+  view_window.block_count = blocks;
+  view_window.size = bytes;
+  view_window.line_checkpoints[blocks] = lines;
+  view_window.first_block = 0;
+  view_file.size = 0;
+  return 1;
+}
+
+/*
+ * Starts loading the file for viewing. Only the blocks of the first page are loaded here, and the
+ * other blocks are loaded by the view menu between keypresses. Returns 1 if loading is started, 0
+ * if an error occurred, or -1 if the file doesn't fit in memory.
+ */
+static int start_loading_view_file(unsigned char device, const struct cbm_dirent *entry)
+{
+  const char *error;
+  int res;
+  res = file_load_open(&view_file, device, entry->name, entry->type, entry->size, &error);
+  if(res == -2) return -1;
+  if(res == -1) {
+    message_dialog_set("Error", error);
+    message_dialog_draw();
+    message_dialog_loop();
+    return 0;
+  }
+  text_set(entry->type);
+  while(text_line_count() < screen_height) {
+    res = file_load_next(&view_file, &error);
+    if(res <= 0) {
+      file_load_close();
+      if(res == -1) {
+        message_dialog_set("Error", error);
+        file_free(&view_file);
+        message_dialog_draw();
+        message_dialog_loop();
+        return 0;
+      }
+      break;
+    }
+    text_append();
+  }
+  return 1;
+}
+
+/*
+ * Loads the file for viewing. A file that doesn't fit in memory is viewed by a window.
+ */
+static char load_view_file(unsigned char device, const struct cbm_dirent *entry)
+{
+  int res;
+  if(entry->size <= 254) {
+    res = start_loading_view_file(device, entry);
+    if(res != -1) return res;
+  }
+  if(!load_file_window(device, entry)) return 0;
+  text_set(view_window.type);
+  return 1;
+}
+
+/*
+ * Loads the viewed file at least to the size, so that the view can be moved there.
+ */
+static void load_view_file_to(unsigned long size)
+{
+  const char *error;
+  while(file_is_loading() && view_file.size < size) {
+    int res = file_load_next(&view_file, &error);
+    if(res <= 0) {
+      file_load_close();
+      if(res == -1) {
+        message_dialog_set("Error", error);
+        message_dialog_draw();
+        message_dialog_loop();
+      }
+      break;
+    }
+    text_append();
+  }
+}
+
+/*
+ * Views the file. The view can be moved to the match at the offset.
+ */
+static void view_file_at(unsigned char device, const struct cbm_dirent *entry, const unsigned long *match_offset)
+{
+  if(!load_view_file(device, entry)) return;
+  if(match_offset != NULL) load_view_file_to(*match_offset + search_pattern_len());
+  screen_begin_page();
+  screen_clear();
+  view_menu_draw();
+  text_draw();
+  screen_end_page();
+  if(match_offset != NULL) text_go_to_match(*match_offset);
+  view_menu_loop();
+  file_load_close();
+  text_free();
+  file_free(&view_file);
+  file_window_free(&view_window);
+  redraw();
+}
+
+/*
+ * Searches the file for the pattern through a small buffer. The end of the buffer is kept for the
+ * next block, so that a match across two blocks isn't missed. Returns 1 with the offset of the
+ * match, 0 if the file doesn't contain the pattern, -1 with the message for an error, or -2 if
+ * RUN/STOP is pressed.
+ */
+static int grep_file(unsigned char device, const struct cbm_dirent *entry, unsigned long *offset, unsigned long *bytes, const char **msg)
+{
+  static char buf[SEARCH_PATTERN_MAX - 1 + BUFFER_SIZE];
+  static char cbm_file_name[16 + 1 + 3 + 1 + 1 + 1];
+  unsigned char pattern_len = search_pattern_len();
+  unsigned char lfn = 14;
+  unsigned long buf_offset = 0;
+  unsigned keep = 0;
+  unsigned len;
+  int res = 0;
+  int res2;
+  char *p;
+  sprintf(cbm_file_name, "%s,%s,r", entry->name, file_type_to_str_for_copy(entry->type));
+  if(cbm_open(lfn, device, 0, cbm_file_name) != 0) {
+    *msg = _stroserror(_oserror);
+    cbm_close(lfn);
+    return -1;
+  }
+  res2 = cmd_channel_read(device, msg, 1);
+  if(res2 != 0) {
+    if(res2 == -1) *msg = _stroserror(_oserror);
+    cbm_close(lfn);
+    if(res2 > 0) cmd_channel_close(device);
+    return -1;
+  }
+  while(1) {
+    if(take_key(CH_STOP)) {
+      res = -2;
+      break;
+    }
+    res2 = cbm_read(lfn, buf + keep, BUFFER_SIZE);
+    if(res2 == -1) {
+      *msg = _stroserror(_oserror);
+      res = -1;
+      break;
+    } else if(res2 == 0)
+      break;
+    *bytes += res2;
+    len = keep + res2;
+    p = search_forward(buf, len);
+    if(p != NULL) {
+      *offset = buf_offset + (p - buf);
+      res = 1;
+      break;
+    }
+    keep = umin(pattern_len - 1, len);
+    memmove(buf, buf + len - keep, keep);
+    buf_offset += len - keep;
+  }
+  cbm_close(lfn);
+  cmd_channel_close(device);
+  return res;
+}
+
+static void show_grep_results(void)
+{
+  int i;
+  if(grep_result_count == 0) {
+    message_dialog_set("Grep", "Pattern not found");
+    message_dialog_draw();
+    message_dialog_loop();
+    return;
+  }
+  list_dialog_set("Grep", grep_labels, grep_result_count);
+  while(1) {
+    list_dialog_draw();
+    i = list_dialog_loop();
+    if(i < 0) break;
+    if(check_device("View")) view_file_at(grep_device, &(grep_results[i].entry), &(grep_results[i].offset));
+  }
+}
+
+/*
+ * Searches the selected files for the pattern, and shows the list of the files that contain the
+ * pattern. The viewer can be opened at the match from the list.
+ */
+static void grep_files(void)
+{
+  static char pattern[SEARCH_PATTERN_MAX + 1];
+  static struct input inputs[1] = {
+    {
+      "Pattern:",
+      pattern,
+      SEARCH_PATTERN_MAX
+    }
+  };
+  static struct progress progresses[1] = {
+    {
+      "Files:",
+      0,
+      PROGRESS_MAX
+    }
+  };
+  unsigned *selected_elem_indices;
+  unsigned selected_elem_index_count;
+  unsigned long offset;
+  unsigned long bytes = 0;
+  const char *error;
+  unsigned i;
+  int res;
+  selected_elem_indices = dir_panel_selected_elem_indices(current_dir_panel, &selected_elem_index_count);
+  if(selected_elem_indices == NULL) {
+    message_dialog_set("Error", "Out of memory");
+    message_dialog_draw();
+    message_dialog_loop();
+    return;
+  }
+  if(selected_elem_index_count == 0) {
+    message_dialog_set("Grep", "No selected files");
+    message_dialog_draw();
+    message_dialog_loop();
+    return;
+  }
+  input_dialog_set("Grep", inputs, 1);
+  input_dialog_draw();
+  if(!input_dialog_loop() || pattern[0] == 0) return;
+  search_set(pattern);
+  grep_device = current_dir_panel->device;
+  grep_result_count = 0;
+  start_transfer("Grep", &(progresses[0]), selected_elem_index_count);
+  for(i = 0; i < selected_elem_index_count && grep_result_count < GREP_RESULT_MAX; i++) {
+    struct cbm_dirent *entry = &(dir_panel_elem(current_dir_panel, selected_elem_indices[i])->entry);
+    if(is_file_type_for_copy(entry->type)) {
+      res = grep_file(grep_device, entry, &offset, &bytes, &error);
+      if(res == -1) {
+        progress_dialog_close();
+        message_dialog_set("Error", error);
+        message_dialog_draw();
+        message_dialog_loop();
+        return;
+      } else if(res == -2)
+        break;
+      else if(res == 1) {
+        struct grep_result *result = &grep_results[grep_result_count];
+        result->entry = *entry;
+        result->offset = offset;
+        sprintf(result->label, "%-16s %6lu", entry->name, offset);
+        grep_labels[grep_result_count] = result->label;
+        grep_result_count++;
+      }
+    }
+    update_transfer(i + 1, bytes);
+  }
+  progress_dialog_close();
+  show_grep_results();
+}
+
 static void save_file(void)
 {
   static char file_name[17];
@@ -871,13 +1521,15 @@ static void save_file(void)
   static char cbm_file_name[16 + 1 + 3 + 1 + 1 + 1];
   unsigned char device;
   int file_type;
-  unsigned bytes, blocks;
-  unsigned size_in_bytes, size_in_blocks;
+  static char buf[BUFFER_SIZE];
+  unsigned long bytes;
+  unsigned blocks;
+  unsigned size_in_blocks;
   unsigned char lfn = 14;
   unsigned char res;
   int res2;
   const char *error;
-  if(loaded_file.content == NULL) {
+  if(!loaded_file.is_loaded) {
     message_dialog_set("Save", "No loaded file");
     message_dialog_draw();
     message_dialog_loop();
@@ -888,16 +1540,11 @@ static void save_file(void)
   while(1) {
     input_dialog_set("Save", inputs, 2);
     input_dialog_draw();
-    if(!input_dialog_loop()) {
-      redraw();
-      return;
-    }
-    redraw();
+    if(!input_dialog_loop()) return;
     if(!check_file_name(file_name)) {
       message_dialog_set("Field", "Incorrect file name");
       message_dialog_draw();
       message_dialog_loop();
-      redraw();
       continue;
     }
     file_type = str_to_file_type_for_copy(file_type_buf);
@@ -905,92 +1552,77 @@ static void save_file(void)
       message_dialog_set("Field", "Incorrect file type");
       message_dialog_draw();
       message_dialog_loop();
-      redraw();
       continue;
     }
     break;
   }
   device = current_dir_panel->device;
-  size_in_bytes = loaded_file.size;
   size_in_blocks = loaded_file_ext.size_in_blocks;
-  progress_dialog_set("Saving", progresses, 1);
   sprintf(file_name_with_colon, "%s:", file_name);
-  if(size_in_blocks != 0)
-    progresses[0].count = 0;
-  else
-    progresses[0].count = PROGRESS_MAX;
-  progress_dialog_draw();
+  start_transfer("Saving", &(progresses[0]), size_in_blocks);
   sprintf(cbm_file_name, "%s,%s,w", file_name,  file_type_to_str_for_copy2(file_type, loaded_file_ext.type));
-  res2 = delete_file(device, file_name, &error);
+  res2 = file_delete(device, file_name, &error);
   if(res2 == -1) {
-    redraw();
+    progress_dialog_close();
     message_dialog_set("Error", _stroserror(_oserror));
     message_dialog_draw();
     message_dialog_loop();
-    redraw();
     dir_panel_reload(current_dir_panel);
     return;
   }
   res = cbm_open(lfn, device, 1, cbm_file_name);
   if(res != 0) {
-    redraw();
+    progress_dialog_close();
     message_dialog_set("Error", _stroserror(_oserror));
     cbm_close(lfn);
     message_dialog_draw();
     message_dialog_loop();
-    redraw();
     dir_panel_reload(current_dir_panel);
     return;
   }
   res2 = cmd_channel_read(device, &error, 1);
   if(res2 == -1) {
-    redraw();
+    progress_dialog_close();
     message_dialog_set("Error", _stroserror(_oserror));
     cbm_close(lfn);
     message_dialog_draw();
     message_dialog_loop();
-    redraw();
     dir_panel_reload(current_dir_panel);
     return;
   } else if(res2 > 0) {
-    redraw();
+    progress_dialog_close();
     message_dialog_set("Error", error);
     cbm_close(lfn);
     cmd_channel_close(device);
     message_dialog_draw();
     message_dialog_loop();
-    redraw();
     dir_panel_reload(current_dir_panel);
     return;
   }
   bytes = 0;
   blocks = 0;
-  while(bytes < size_in_bytes) {
-    unsigned size = umin(size_in_bytes - bytes, BUFFER_SIZE); 
-    res2 = cbm_write(lfn, loaded_file.content + bytes, size);
+  chunked_file_rewind(&loaded_file);
+  while(1) {
+    unsigned size = chunked_file_read(&loaded_file, buf, BUFFER_SIZE);
+    if(size == 0) break;
+    res2 = cbm_write(lfn, buf, size);
     if(res2 == -1) {
-      redraw();
+      progress_dialog_close();
       message_dialog_set("Error", _stroserror(_oserror));
       cbm_close(lfn);
       cmd_channel_close(device);
       message_dialog_draw();
       message_dialog_loop();
-      redraw();
       dir_panel_reload(current_dir_panel);
       return;
     }
     bytes += size;
     blocks++;
-    if(size_in_blocks != 0)
-      progresses[0].count = (((unsigned long) blocks) * PROGRESS_MAX) / size_in_blocks;
-    else
-      progresses[0].count = PROGRESS_MAX;
-    progresses[0].count = umin(PROGRESS_MAX, progresses[0].count);
-    progress_dialog_draw();
+    update_transfer(blocks, bytes);
   }
   cbm_close(lfn);
   cmd_channel_close(device);
-  redraw();
+  progress_dialog_close();
   dir_panel_reload(current_dir_panel);
 }
 
@@ -998,46 +1630,47 @@ void main_menu_loop(void)
 {
   unsigned char is_exit = 0;
   while(!is_exit) {
+    show_job_message();
+    if(job_is_running() && !kbhit()) {
+      step_job();
+      continue;
+    }
     switch(cgetc()) {
     case CH_CURS_UP:
-      dir_panel_move_cursor_up(current_dir_panel);
+      dir_panel_move_cursor_up(current_dir_panel, drain_key(CH_CURS_UP));
       break;
     case CH_CURS_DOWN:
-      dir_panel_move_cursor_down(current_dir_panel);
+      dir_panel_move_cursor_down(current_dir_panel, drain_key(CH_CURS_DOWN));
       break;
     case ' ':
       dir_panel_select_or_unselect(current_dir_panel);
       break;
+    case '+':
+      select_group(1);
+      break;
+    case '-':
+      select_group(0);
+      break;
+    case '*':
+      dir_panel_invert_selection(current_dir_panel);
+      break;
+    case '=':
+      dir_panel_select_all(current_dir_panel);
+      break;
     case '8':
-      current_dir_panel = &dir_panels[0];
-      if(!dir_panel_is_loaded(current_dir_panel))
-        dir_panel_reload(current_dir_panel);
-      else
-        dir_panel_draw(current_dir_panel);
+      change_dir_panel(0);
       break;
     case '9':
-      current_dir_panel = &dir_panels[1];
-      if(!dir_panel_is_loaded(current_dir_panel))
-        dir_panel_reload(current_dir_panel);
-      else
-        dir_panel_draw(current_dir_panel);
+      change_dir_panel(1);
       break;
     case '0':
-      current_dir_panel = &dir_panels[2];
-      if(!dir_panel_is_loaded(current_dir_panel))
-        dir_panel_reload(current_dir_panel);
-      else
-        dir_panel_draw(current_dir_panel);
+      change_dir_panel(2);
       break;
     case '1':
-      current_dir_panel = &dir_panels[3];
-      if(!dir_panel_is_loaded(current_dir_panel))
-        dir_panel_reload(current_dir_panel);
-      else
-        dir_panel_draw(current_dir_panel);
+      change_dir_panel(3);
       break;
     case 'r':
-      dir_panel_reload(current_dir_panel);
+      if(check_device("Reload")) dir_panel_reload(current_dir_panel);
       break;
     case 'c':
       copy_files();
@@ -1045,42 +1678,61 @@ void main_menu_loop(void)
     case 'n':
       rename_files();
       break;
+    case 'y':
+      sync_dirs();
+      break;
+    case 'u':
+      resume_copying();
+      break;
+    case 'p':
+      prefetch_dirs();
+      break;
+    case CH_STOP:
+      stop_job();
+      break;
     case 'd':
       delete_files();
       break;
     case 'l':
-      load_file("Load", &loaded_file, &loaded_file_ext);
+      if(check_device("Load")) load_file("Load", &loaded_file, &loaded_file_ext);
       break;
     case 's':
-      save_file();
+      if(check_device("Save")) save_file();
       break;
     case 'f':
-      file_free(&loaded_file);
+      chunked_file_free(&loaded_file);
       break;
     case 'v':
-      if(load_file("View", &view_file, NULL)) {
-        screen_clear();
-        view_menu_draw();
-        text_set();
-        text_draw();
-        view_menu_loop();
-        file_free(&view_file);
-        redraw();
-      }
+      if(check_device("View") && check_file_for_load("View"))
+        view_file_at(current_dir_panel->device, &(dir_panel_elem(current_dir_panel, current_dir_panel->cursor_y)->entry), NULL);
+      break;
+    case '/':
+      find_file();
+      break;
+    case '.':
+      if(find_pattern[0] != 0)
+        find_next_file();
+      else
+        find_file();
+      break;
+    case 'g':
+      if(check_device("Grep")) grep_files();
+      break;
+    case 'h':
+      show_help();
       break;
     case 'a':
       about_dialog_set();
       about_dialog_draw();
       about_dialog_loop();
-      redraw();
       break;
     case 'q':
-      yes_no_dialog_set("Quit", "Quit SFM64?");
-      yes_no_dialog_draw();
-      if(yes_no_dialog_loop())
-        is_exit = 1;
+      if(job_is_running())
+        yes_no_dialog_set("Quit", "Stop jobs and quit?");
       else
-        redraw();
+        yes_no_dialog_set("Quit", "Quit SFM64?");
+      yes_no_dialog_draw();
+      if(yes_no_dialog_loop()) is_exit = 1;
       break;
     }
   }
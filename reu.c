@@ -0,0 +1,86 @@
+/*
+ * Simple file manager for Commodore 64.
+ * Copyright (C) 2019 Łukasz Szpakowski
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "reu.h"
+
+/*
+ * The registers of the RAM Expansion Unit. A transfer is started immediately by writing the
+ * command register because the trigger at $FF00 is disabled in the commands.
+ */
+#define REU_COMMAND                     (*((unsigned char *) 0xdf01))
+#define REU_C64_ADDR_LO                 (*((unsigned char *) 0xdf02))
+#define REU_C64_ADDR_HI                 (*((unsigned char *) 0xdf03))
+#define REU_REU_ADDR_LO                 (*((unsigned char *) 0xdf04))
+#define REU_REU_ADDR_HI                 (*((unsigned char *) 0xdf05))
+#define REU_REU_BANK                    (*((unsigned char *) 0xdf06))
+#define REU_LENGTH_LO                   (*((unsigned char *) 0xdf07))
+#define REU_LENGTH_HI                   (*((unsigned char *) 0xdf08))
+#define REU_ADDR_CONTROL                (*((unsigned char *) 0xdf0a))
+
+#define REU_COMMAND_STASH               0x90
+#define REU_COMMAND_FETCH               0x91
+
+#define REU_BANK_MAX                    16
+
+unsigned char reu_bank_count;
+
+static void transfer(unsigned char command, void *c64_addr, unsigned long reu_addr, unsigned size)
+{
+  if(size == 0) return;
+  REU_C64_ADDR_LO = ((unsigned) c64_addr) & 0xff;
+  REU_C64_ADDR_HI = ((unsigned) c64_addr) >> 8;
+  REU_REU_ADDR_LO = reu_addr & 0xff;
+  REU_REU_ADDR_HI = (reu_addr >> 8) & 0xff;
+  REU_REU_BANK = reu_addr >> 16;
+  REU_LENGTH_LO = size & 0xff;
+  REU_LENGTH_HI = size >> 8;
+  REU_ADDR_CONTROL = 0;
+  REU_COMMAND = command;
+}
+
+/*
+ * Detects the REU by its address registers that keep written values, and then counts its banks.
+ * The banks are marked from the last to the first, so a bank that doesn't exist wraps to a smaller
+ * bank and loses its mark.
+ */
+void initialize_reu(void)
+{
+  unsigned char i;
+  unsigned char mark;
+  reu_bank_count = 0;
+  REU_REU_ADDR_LO = 0x55;
+  REU_REU_ADDR_HI = 0xaa;
+  if(REU_REU_ADDR_LO != 0x55 || REU_REU_ADDR_HI != 0xaa) return;
+  for(i = REU_BANK_MAX; i > 0; i--) {
+    mark = i - 1;
+    reu_stash((unsigned long) mark << 16, &mark, 1);
+  }
+  for(i = 0; i < REU_BANK_MAX; i++) {
+    reu_fetch(&mark, (unsigned long) i << 16, 1);
+    if(mark != i) break;
+  }
+  reu_bank_count = i;
+}
+
+void reu_stash(unsigned long reu_addr, const void *src, unsigned size)
+{ transfer(REU_COMMAND_STASH, (void *) src, reu_addr, size); }
+
+void reu_fetch(void *dst, unsigned long reu_addr, unsigned size)
+{ transfer(REU_COMMAND_FETCH, dst, reu_addr, size); }
+
+unsigned long reu_size(void)
+{ return reu_bank_count * REU_BANK_SIZE; }
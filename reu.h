@@ -0,0 +1,36 @@
+/*
+ * Simple file manager for Commodore 64.
+ * Copyright (C) 2019 Łukasz Szpakowski
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _REU_H
+#define _REU_H
+
+/*
+ * The layout of the REU memory. The loaded file is stored from the start of the REU and can use
+ * the whole REU. The blocks of the viewed file are stored after the loaded file.
+ */
+#define REU_BANK_SIZE                   0x10000UL
+#define REU_LOADED_FILE_ADDR            0UL
+
+extern unsigned char reu_bank_count;
+
+void initialize_reu(void);
+
+void reu_stash(unsigned long reu_addr, const void *src, unsigned size);
+void reu_fetch(void *dst, unsigned long reu_addr, unsigned size);
+unsigned long reu_size(void);
+
+#endif
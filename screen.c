@@ -15,32 +15,365 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <6502.h>
 #include <conio.h>
+#include <string.h>
 #include "screen.h"
 
+/*
+ * The VIC uses the last bank, so there is place for two screen pages. The character set is copied from
+ * the character ROM because the VIC doesn't see the character ROM in this bank. The memory from
+ * SCREEN_BANK to $CFFF is reserved by setting __HIMEM__ to $C000 for the linker.
+ */
+#define SCREEN_BANK_ADDR                0xc000
+#define SCREEN_BANK                     ((unsigned char *) SCREEN_BANK_ADDR)
+#define SCREEN_PAGE_SIZE                0x0400
+#define SCREEN_CHARSET                  ((unsigned char *) 0xc800)
+#define SCREEN_CHARSET_SIZE             0x0800
+#define SCREEN_CHAR_ROM                 ((unsigned char *) 0xd000)
+#define SCREEN_COLOR_RAM                ((unsigned char *) 0xd800)
+#define SCREEN_FLIP_RASTERLINE          251
+#define SCREEN_FLIP_RASTERLINE_END      40
+
+#define CPU_PORT                        (*((unsigned char *) 0x0001))
+#define KERNAL_SCREEN_PAGE              (*((unsigned char *) 0x0288))
+
 unsigned char screen_width;
 unsigned char screen_height;
 
 static unsigned char saved_border_color;
 static unsigned char saved_bg_color;
 static unsigned char saved_fg_color;
+static unsigned char saved_cia2_pra;
+static unsigned char saved_vic_addr;
+static unsigned char saved_kernal_screen_page;
+
+/*
+ * Characters are written directly to the screen RAM and the color RAM. The addresses of rows are
+ * precomputed and characters are converted to screen codes by the table, so drawing of a character
+ * doesn't call the KERNAL.
+ */
+static unsigned char *rows[SCREEN_HEIGHT];
+static unsigned char *color_rows[SCREEN_HEIGHT];
+static unsigned char screen_codes[256];
+static unsigned char *ptr;
+static unsigned char *color_ptr;
+static unsigned char revers_mask;
+static unsigned char color;
+static unsigned char shown_page;
+static unsigned char back_color_ram[SCREEN_WIDTH * SCREEN_HEIGHT];
+
+static unsigned char char_to_screen_code(unsigned char c)
+{
+  if(c < 0x20)
+    return '.';
+  else if(c < 0x40)
+    return c;
+  else if(c < 0x60)
+    return c - 0x40;
+  else if(c < 0x80)
+    return c - 0x20;
+  else if(c < 0xa0)
+    return '.';
+  else if(c < 0xc0)
+    return c - 0x40;
+  else if(c < 0xff)
+    return c - 0x80;
+  else
+    return 0x5e;
+}
+
+static unsigned char *page_addr(unsigned char page)
+{ return SCREEN_BANK + page * SCREEN_PAGE_SIZE; }
+
+static void set_rows(unsigned char *screen_ram, unsigned char *color_ram)
+{
+  unsigned char i;
+  for(i = 0; i < SCREEN_HEIGHT; i++) {
+    rows[i] = screen_ram + i * SCREEN_WIDTH;
+    color_rows[i] = color_ram + i * SCREEN_WIDTH;
+  }
+}
+
+/*
+ * Checks whether the raster is below the visible area or at the top before the visible area. The
+ * lines from 256 have the eighth bit of the raster line in the control register.
+ */
+static char is_raster_in_border(void)
+{
+  return (VIC.ctrl1 & 0x80) != 0 || VIC.rasterline >= SCREEN_FLIP_RASTERLINE || VIC.rasterline < SCREEN_FLIP_RASTERLINE_END;
+}
+
+/*
+ * Shows the screen page. The screen page is switched when the raster is in the border. The raster
+ * is checked for a range of lines, so an interrupt at the first line of the border doesn't delay
+ * the switch by a frame.
+ */
+static void show_page(unsigned char page)
+{
+  while(!is_raster_in_border());
+  VIC.addr = (page << 4) | ((SCREEN_CHARSET - SCREEN_BANK) >> 10);
+  KERNAL_SCREEN_PAGE = (SCREEN_BANK_ADDR + page * SCREEN_PAGE_SIZE) >> 8;
+  shown_page = page;
+}
 
 void initialize_screen(void)
 {
+  unsigned i;
+  unsigned char *char_rom;
   saved_border_color = bordercolor(SCREEN_COLOR_BACKGROUND);
   saved_bg_color = bgcolor(SCREEN_COLOR_BACKGROUND);
   saved_fg_color = textcolor(SCREEN_COLOR_FOREGROUND);
   clrscr();
   screensize(&screen_width, &screen_height);
+  saved_cia2_pra = CIA2.pra;
+  saved_vic_addr = VIC.addr;
+  saved_kernal_screen_page = KERNAL_SCREEN_PAGE;
+  /* The lower case character set is in the second half of the character ROM. */
+  char_rom = SCREEN_CHAR_ROM + ((VIC.addr & 0x02) != 0 ? SCREEN_CHARSET_SIZE : 0);
+  SEI();
+  CPU_PORT &= ~0x04;
+  memcpy(SCREEN_CHARSET, char_rom, SCREEN_CHARSET_SIZE);
+  CPU_PORT |= 0x04;
+  CLI();
+  memcpy(page_addr(0), (unsigned char *) (((unsigned) saved_kernal_screen_page) << 8), SCREEN_WIDTH * SCREEN_HEIGHT);
+  show_page(0);
+  CIA2.pra = (CIA2.pra & 0xfc);
+  set_rows(page_addr(0), SCREEN_COLOR_RAM);
+  for(i = 0; i < 256; i++) {
+    screen_codes[i] = char_to_screen_code(i);
+  }
+  ptr = rows[0];
+  color_ptr = color_rows[0];
+  revers_mask = 0;
+  color = SCREEN_COLOR_FOREGROUND;
 }
 
 void finalize_screen(void)
 {
+  CIA2.pra = (CIA2.pra & 0xfc) | (saved_cia2_pra & 0x03);
+  VIC.addr = saved_vic_addr;
+  KERNAL_SCREEN_PAGE = saved_kernal_screen_page;
   bordercolor(saved_border_color);
   bgcolor(saved_bg_color);
   textcolor(saved_fg_color);
   clrscr();
 }
 
+/*
+ * Clears the screen page that is drawn.
+ */
 void screen_clear(void)
-{ clrscr(); }
+{
+  memset(rows[0], ' ', SCREEN_WIDTH * SCREEN_HEIGHT);
+  memset(color_rows[0], SCREEN_COLOR_FOREGROUND, SCREEN_WIDTH * SCREEN_HEIGHT);
+}
+
+/*
+ * Starts the drawing of the whole screen to the hidden screen page. Colors are drawn to the buffer
+ * because there is only one color RAM.
+ */
+void screen_begin_page(void)
+{ set_rows(page_addr(shown_page ^ 1), back_color_ram); }
+
+/*
+ * Shows the drawn screen page and copies colors to the color RAM. Further drawing goes to the shown
+ * screen page.
+ */
+void screen_end_page(void)
+{
+  show_page(shown_page ^ 1);
+  memcpy(SCREEN_COLOR_RAM, back_color_ram, SCREEN_WIDTH * SCREEN_HEIGHT);
+  set_rows(page_addr(shown_page), SCREEN_COLOR_RAM);
+}
+
+void screen_goto(unsigned char x, unsigned char y)
+{
+  ptr = rows[y] + x;
+  color_ptr = color_rows[y] + x;
+}
+
+void screen_revers(char is_revers)
+{ revers_mask = (is_revers ? 0x80 : 0); }
+
+void screen_color(unsigned char new_color)
+{ color = new_color; }
+
+/*
+ * Control characters are drawn as '.'.
+ */
+void screen_putc(char c)
+{
+  *ptr = screen_codes[(unsigned char) c] | revers_mask;
+  *color_ptr = color;
+  ptr++;
+  color_ptr++;
+}
+
+void screen_puts(const char *s)
+{
+  unsigned char *start = ptr;
+  while(*s != 0) {
+    *ptr = screen_codes[(unsigned char) *s] | revers_mask;
+    ptr++;
+    s++;
+  }
+  memset(color_ptr, color, ptr - start);
+  color_ptr += ptr - start;
+}
+
+void screen_put_chars(const char *s, unsigned char count)
+{
+  unsigned char i;
+  for(i = 0; i < count; i++) {
+    ptr[i] = screen_codes[(unsigned char) s[i]] | revers_mask;
+  }
+  memset(color_ptr, color, count);
+  ptr += count;
+  color_ptr += count;
+}
+
+void screen_fill(char c, unsigned char count)
+{
+  memset(ptr, screen_codes[(unsigned char) c] | revers_mask, count);
+  memset(color_ptr, color, count);
+  ptr += count;
+  color_ptr += count;
+}
+
+/*
+ * Copies the rectangle of the screen RAM and the color RAM to the buffer. The buffer must have two
+ * bytes for each character.
+ */
+void screen_save(unsigned char x, unsigned char y, unsigned char width, unsigned char height, unsigned char *buf)
+{
+  unsigned char i;
+  for(i = y; i < y + height; i++) {
+    memcpy(buf, rows[i] + x, width);
+    buf += width;
+    memcpy(buf, color_rows[i] + x, width);
+    buf += width;
+  }
+}
+
+void screen_restore(unsigned char x, unsigned char y, unsigned char width, unsigned char height, const unsigned char *buf)
+{
+  unsigned char i;
+  for(i = y; i < y + height; i++) {
+    memcpy(rows[i] + x, buf, width);
+    buf += width;
+    memcpy(color_rows[i] + x, buf, width);
+    buf += width;
+  }
+}
+
+/*
+ * Scrolls the rectangle up by one row. The last row of the rectangle isn't changed.
+ */
+void screen_scroll_up(unsigned char x, unsigned char y, unsigned char width, unsigned char height)
+{
+  unsigned char i;
+  for(i = y; i < y + height - 1; i++) {
+    memcpy(rows[i] + x, rows[i + 1] + x, width);
+    memcpy(color_rows[i] + x, color_rows[i + 1] + x, width);
+  }
+}
+
+/*
+ * Scrolls the rectangle down by one row. The first row of the rectangle isn't changed.
+ */
+void screen_scroll_down(unsigned char x, unsigned char y, unsigned char width, unsigned char height)
+{
+  unsigned char i;
+  for(i = y + height - 1; i > y; i--) {
+    memcpy(rows[i] + x, rows[i - 1] + x, width);
+    memcpy(color_rows[i] + x, color_rows[i - 1] + x, width);
+  }
+}
+
+/*
+ * Shifts the rectangle left by one column. The last column of the rectangle isn't changed.
+ */
+void screen_shift_left(unsigned char x, unsigned char y, unsigned char width, unsigned char height)
+{
+  unsigned char i;
+  for(i = y; i < y + height; i++) {
+    memmove(rows[i] + x, rows[i] + x + 1, width - 1);
+    memmove(color_rows[i] + x, color_rows[i] + x + 1, width - 1);
+  }
+}
+
+/*
+ * Shifts the rectangle right by one column. The first column of the rectangle isn't changed.
+ */
+void screen_shift_right(unsigned char x, unsigned char y, unsigned char width, unsigned char height)
+{
+  unsigned char i;
+  for(i = y; i < y + height; i++) {
+    memmove(rows[i] + x + 1, rows[i] + x, width - 1);
+    memmove(color_rows[i] + x + 1, color_rows[i] + x, width - 1);
+  }
+}
+
+void screen_put_uint(unsigned x, unsigned char width, char pad)
+{
+  static unsigned char buf[5];
+  unsigned char *end = screen_format_uint(buf, x, width, pad);
+  screen_put_codes(buf, end - buf);
+}
+
+/*
+ * Draws screen codes that are formatted by the screen_format functions. The codes are copied and
+ * are reversed if the reverse mode is set.
+ */
+void screen_put_codes(const unsigned char *codes, unsigned char count)
+{
+  if(revers_mask != 0) {
+    unsigned char i;
+    for(i = 0; i < count; i++) {
+      ptr[i] = codes[i] | 0x80;
+    }
+  } else
+    memcpy(ptr, codes, count);
+  memset(color_ptr, color, count);
+  ptr += count;
+  color_ptr += count;
+}
+
+unsigned char *screen_format_str(unsigned char *buf, const char *s)
+{
+  while(*s != 0) {
+    *buf = screen_codes[(unsigned char) *s];
+    buf++;
+    s++;
+  }
+  return buf;
+}
+
+unsigned char *screen_format_fill(unsigned char *buf, char c, unsigned char count)
+{
+  memset(buf, screen_codes[(unsigned char) c], count);
+  return buf + count;
+}
+
+/*
+ * Formats the unsigned integer that is right-aligned to the width and is padded by the character.
+ * The width is at most 5.
+ */
+unsigned char *screen_format_uint(unsigned char *buf, unsigned x, unsigned char width, char pad)
+{
+  static unsigned char digits[5];
+  unsigned char i = 0;
+  do {
+    digits[i] = '0' + x % 10;
+    x /= 10;
+    i++;
+  } while(x != 0 && i < 5);
+  if(width > i) buf = screen_format_fill(buf, pad, width - i);
+  while(i > 0) {
+    i--;
+    *buf = digits[i];
+    buf++;
+  }
+  return buf;
+}
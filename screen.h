@@ -24,6 +24,9 @@
 #define SCREEN_COLOR_FOREGROUND         COLOR_GRAY1
 #define SCREEN_COLOR_CURSOR             COLOR_GRAY2
 
+#define SCREEN_WIDTH                    40
+#define SCREEN_HEIGHT                   25
+
 extern unsigned char screen_width;
 extern unsigned char screen_height;
 
@@ -31,5 +34,25 @@ void initialize_screen(void);
 void finalize_screen(void);
 
 void screen_clear(void);
+void screen_begin_page(void);
+void screen_end_page(void);
+void screen_goto(unsigned char x, unsigned char y);
+void screen_revers(char is_revers);
+void screen_color(unsigned char color);
+void screen_putc(char c);
+void screen_puts(const char *s);
+void screen_put_chars(const char *s, unsigned char count);
+void screen_fill(char c, unsigned char count);
+void screen_put_uint(unsigned x, unsigned char width, char pad);
+void screen_put_codes(const unsigned char *codes, unsigned char count);
+unsigned char *screen_format_str(unsigned char *buf, const char *s);
+unsigned char *screen_format_fill(unsigned char *buf, char c, unsigned char count);
+unsigned char *screen_format_uint(unsigned char *buf, unsigned x, unsigned char width, char pad);
+void screen_save(unsigned char x, unsigned char y, unsigned char width, unsigned char height, unsigned char *buf);
+void screen_restore(unsigned char x, unsigned char y, unsigned char width, unsigned char height, const unsigned char *buf);
+void screen_scroll_up(unsigned char x, unsigned char y, unsigned char width, unsigned char height);
+void screen_scroll_down(unsigned char x, unsigned char y, unsigned char width, unsigned char height);
+void screen_shift_left(unsigned char x, unsigned char y, unsigned char width, unsigned char height);
+void screen_shift_right(unsigned char x, unsigned char y, unsigned char width, unsigned char height);
 
 #endif
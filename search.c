@@ -0,0 +1,101 @@
+/*
+ * Simple file manager for Commodore 64.
+ * Copyright (C) 2019 Łukasz Szpakowski
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stddef.h>
+#include <string.h>
+#include "search.h"
+
+/*
+ * The search uses the Boyer-Moore-Horspool algorithm. The skip tables have one byte for every
+ * character, so the pattern is shorter than 256 characters and the skips are 8-bit.
+ */
+static char pattern[SEARCH_PATTERN_MAX + 1];
+static unsigned char pattern_len;
+static unsigned char forward_skips[256];
+static unsigned char backward_skips[256];
+
+/*
+ * The forward skip of the character is the distance of its last occurrence before the last
+ * character of the pattern to the end of the pattern. The backward skip is the distance of its
+ * first occurrence after the first character of the pattern to the start of the pattern.
+ */
+void search_set(const char *new_pattern)
+{
+  unsigned char i;
+  strncpy(pattern, new_pattern, SEARCH_PATTERN_MAX);
+  pattern[SEARCH_PATTERN_MAX] = 0;
+  pattern_len = strlen(pattern);
+  memset(forward_skips, pattern_len, 256);
+  memset(backward_skips, pattern_len, 256);
+  if(pattern_len == 0) return;
+  for(i = 0; i < pattern_len - 1; i++) forward_skips[(unsigned char) pattern[i]] = pattern_len - 1 - i;
+  for(i = pattern_len - 1; i > 0; i--) backward_skips[(unsigned char) pattern[i]] = i;
+}
+
+unsigned char search_pattern_len(void)
+{ return pattern_len; }
+
+/*
+ * Returns the first occurrence of the pattern in the buffer or NULL. The last character of the
+ * window is compared first, because it is loaded for the skip anyway.
+ */
+char *search_forward(char *s, unsigned len)
+{
+  char *last;
+  char *end;
+  char c;
+  unsigned char i;
+  if(pattern_len == 0 || len < pattern_len) return NULL;
+  c = pattern[pattern_len - 1];
+  last = s + (pattern_len - 1);
+  end = s + len;
+  while(last < end) {
+    char d = *last;
+    if(d == c) {
+      char *p = last - (pattern_len - 1);
+      for(i = 0; i < pattern_len - 1 && p[i] == pattern[i]; i++);
+      if(i == pattern_len - 1) return p;
+    }
+    last += forward_skips[(unsigned char) d];
+  }
+  return NULL;
+}
+
+/*
+ * Returns the last occurrence of the pattern in the buffer or NULL.
+ */
+char *search_backward(char *s, unsigned len)
+{
+  unsigned pos;
+  char c;
+  unsigned char i;
+  unsigned char skip;
+  if(pattern_len == 0 || len < pattern_len) return NULL;
+  c = pattern[0];
+  pos = len - pattern_len;
+  while(1) {
+    char d = s[pos];
+    if(d == c) {
+      for(i = 1; i < pattern_len && s[pos + i] == pattern[i]; i++);
+      if(i == pattern_len) return s + pos;
+    }
+    skip = backward_skips[(unsigned char) d];
+    if(pos < skip) break;
+    pos -= skip;
+  }
+  return NULL;
+}
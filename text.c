@@ -15,142 +15,959 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
-#include <conio.h>
+#include <cbm.h>
+#include <errno.h>
 #include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dialog.h"
 #include "file.h"
 #include "screen.h"
+#include "search.h"
 #include "text.h"
 #include "util.h"
 
+/*
+ * The line index holds the offset of every 2^line_offset_shift-th line of the window. When the
+ * index is full, every second offset is dropped and the shift is incremented.
+ */
+#define TEXT_LINE_OFFSET_MAX            512
+
+#define HEX_ROW_BYTE_COUNT              8
+#define HEX_ROW_PREFIX_LEN              29
+
 struct text
 {
+  unsigned *line_offsets;
+  unsigned char line_offset_shift;
   unsigned line_count;
   unsigned max_line_char_count;
+  char *window_start;
+  unsigned window_first_line;
+  unsigned window_line_count;
+  unsigned scanned_size;
+  unsigned line_char_count;
   unsigned view_y;
   unsigned view_x;
   char *view_y_ptr;
+  char is_hex;
+  unsigned other_view_y;
+  char is_prg;
+  char has_load_address;
+  unsigned load_address;
+  char has_match;
+  unsigned long match_offset;
+  unsigned match_line;
+  char is_wrapped;
+  unsigned view_row;
 };
 
 static struct text text;
 
+static const char hex_digits[16] = "0123456789abcdef";
+
 void initialize_text(void)
 {
+  text.line_offsets = NULL;
+  text.line_offset_shift = 0;
   text.line_count = 0;
   text.max_line_char_count = 0;
+  text.window_start = NULL;
+  text.window_first_line = 0;
+  text.window_line_count = 0;
+  text.scanned_size = 0;
+  text.line_char_count = 0;
   text.view_y = 0;
   text.view_x = 0;
   text.view_y_ptr = NULL;
+  text.is_hex = 0;
+  text.other_view_y = 0;
+  text.is_prg = 0;
+  text.has_load_address = 0;
+  text.load_address = 0;
+  text.has_match = 0;
+  text.match_offset = 0;
+  text.match_line = 0;
+  text.is_wrapped = 0;
+  text.view_row = 0;
+}
+
+void finalize_text(void)
+{
+  text_free();
+}
+
+void text_free(void)
+{
+  free(text.line_offsets);
+  text.line_offsets = NULL;
 }
 
-void finalize_text(void) {}
+static void reset_index(void)
+{
+  text.line_offset_shift = 0;
+  /* Without the index, lines are found from the start of the window. */
+  if(text.line_offsets == NULL)
+    text.line_offsets = (unsigned *) malloc(sizeof(unsigned) * TEXT_LINE_OFFSET_MAX);
+}
 
-void text_set(void)
+/*
+ * Adds the line of the window to the index. The lines must be added in order.
+ */
+static void index_line(unsigned y, char *s)
 {
-  char *s = view_file.content;
+  unsigned i;
+  if(text.line_offsets == NULL) return;
+  if((y & ((1U << text.line_offset_shift) - 1)) != 0) return;
+  if((y >> text.line_offset_shift) >= TEXT_LINE_OFFSET_MAX) {
+    for(i = 0; i < TEXT_LINE_OFFSET_MAX / 2; i++) text.line_offsets[i] = text.line_offsets[i * 2];
+    text.line_offset_shift++;
+    if((y & ((1U << text.line_offset_shift) - 1)) != 0) return;
+  }
+  text.line_offsets[y >> text.line_offset_shift] = s - view_file.content;
+}
+
+/*
+ * Counts and indexes the lines of the content that haven't been scanned yet.
+ */
+static void scan_lines(void)
+{
+  char *s = view_file.content + text.scanned_size;
   char *end = view_file.content + view_file.size;
-  unsigned line_char_count = 0;
-  text.line_count = 0;
-  text.max_line_char_count = 0;
-  while(1) {
-    if(s >= end || *s == '\n') {
-      text.line_count++;
-      text.max_line_char_count = umax(text.max_line_char_count, line_char_count);
-      line_char_count = 0;
-      if(s >= end) break;
+  for(; s < end; s++) {
+    if(*s == '\n') {
+      index_line(text.window_line_count, s + 1);
+      text.window_line_count++;
+      text.max_line_char_count = umax(text.max_line_char_count, text.line_char_count);
+      text.line_char_count = 0;
     } else
-      line_char_count++;
-    s++;
+      text.line_char_count++;
   }
-  text.view_y = 0;
+  text.max_line_char_count = umax(text.max_line_char_count, text.line_char_count);
+  text.scanned_size = view_file.size;
+  text.line_count = text.window_line_count;
+}
+
+static char *line_end(char *s)
+{
+  char *end = view_file.content + view_file.size;
+  char *nl = memchr(s, '\n', end - s);
+  return nl != NULL ? nl : end;
+}
+
+static char *next_line(char *s)
+{
+  char *end = view_file.content + view_file.size;
+  s = line_end(s);
+  /* \n */
+  return s < end ? s + 1 : s;
+}
+
+/*
+ * Returns the pointer to the line. A line outside the window is empty.
+ */
+static char *line_ptr(unsigned y)
+{
+  char *s = text.window_start;
+  if(y < text.window_first_line || y - text.window_first_line >= text.window_line_count)
+    return view_file.content + view_file.size;
+  y -= text.window_first_line;
+  if(text.line_offsets != NULL) {
+    s = view_file.content + text.line_offsets[y >> text.line_offset_shift];
+    y &= (1U << text.line_offset_shift) - 1;
+  }
+  for(; y > 0; y--) s = next_line(s);
+  return s;
+}
+
+/*
+ * Reads the window from the block. The lines of the window have to be found again after it.
+ */
+static char read_window(unsigned block)
+{
+  const char *error;
+  int res = file_read_window(&view_window, &view_file, block, &error);
+  text.window_start = view_file.content;
+  text.window_first_line = 0;
+  text.window_line_count = 0;
+  if(res != 0) {
+    view_file.size = 0;
+    text_free();
+    message_dialog_set("Error", res == -1 ? _stroserror(_oserror) : error);
+    message_dialog_draw();
+    message_dialog_loop();
+    return 0;
+  }
+  return 1;
+}
+
+/*
+ * Reads the window from the block and finds the lines that begin in it.
+ */
+static char read_window_lines(unsigned block)
+{
+  unsigned *checkpoints = view_window.line_checkpoints;
+  char *end;
+  char *s;
+  char is_end;
+  if(!read_window(block)) return 0;
+  end = view_file.content + view_file.size;
+  if(block > 0) {
+    /* The first line of the window is the first line that begins in the window. */
+    s = memchr(view_file.content, '\n', view_file.size);
+    text.window_start = s != NULL ? s + 1 : end;
+    text.window_first_line = checkpoints[block] + 1;
+  } else {
+    text.window_start = view_file.content;
+    text.window_first_line = 0;
+  }
+  /* The last line of the file hasn't the new line character. */
+  is_end = block + (view_file.size + FILE_BLOCK_SIZE - 1) / FILE_BLOCK_SIZE >= view_window.block_count;
+  reset_index();
+  text.window_line_count = 0;
+  s = text.window_start;
+  while(1) {
+    char *nl = memchr(s, '\n', end - s);
+    if(nl == NULL && !is_end) break;
+    index_line(text.window_line_count, s);
+    text.window_line_count++;
+    if(nl == NULL) break;
+    s = nl + 1;
+  }
+  return 1;
+}
+
+/*
+ * Refills the window of the viewed file, so that it holds the lines of the view at the line. The
+ * window begins a quarter of its capacity before the block of the line, so that moving the view up
+ * doesn't refill it at once.
+ */
+static void fill_window(unsigned y)
+{
+  unsigned *checkpoints = view_window.line_checkpoints;
+  unsigned end_y = umin(y + screen_height - 1, text.line_count);
+  unsigned lo, hi;
+  if(checkpoints == NULL) return;
+  if(y >= text.window_first_line && end_y <= text.window_first_line + text.window_line_count) return;
+  /* Finds the last block that begins before the line. */
+  lo = 0;
+  hi = view_window.block_count > 0 ? view_window.block_count - 1 : 0;
+  while(lo < hi) {
+    unsigned mid = lo + (hi - lo + 1) / 2;
+    if(checkpoints[mid] < y)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  read_window_lines(lo - umin(lo, view_window.capacity_in_blocks / 4));
+}
+
+static unsigned long window_offset(void)
+{
+  return view_window.line_checkpoints != NULL ? (unsigned long) view_window.first_block * FILE_BLOCK_SIZE : 0;
+}
+
+static unsigned long file_size(void)
+{
+  return view_window.line_checkpoints != NULL ? view_window.size : view_file.size;
+}
+
+static unsigned hex_row_count(void)
+{
+  return (unsigned) ((file_size() + HEX_ROW_BYTE_COUNT - 1) / HEX_ROW_BYTE_COUNT);
+}
+
+/*
+ * Refills the window of the viewed file, so that it holds the bytes of the hex view at the row.
+ * The offset of the row is computed from the row without scanning.
+ */
+static void fill_hex_window(unsigned y)
+{
+  unsigned long offset = (unsigned long) y * HEX_ROW_BYTE_COUNT;
+  unsigned long end_offset = offset + (screen_height - 1) * HEX_ROW_BYTE_COUNT;
+  unsigned block;
+  if(view_window.line_checkpoints == NULL) return;
+  if(end_offset > view_window.size) end_offset = view_window.size;
+  if(offset >= window_offset() && end_offset <= window_offset() + view_file.size) return;
+  block = (unsigned) (offset / FILE_BLOCK_SIZE);
+  read_window(block - umin(block, view_window.capacity_in_blocks / 4));
+}
+
+/*
+ * The load address is in the first two bytes of a PRG file.
+ */
+static void update_load_address(void)
+{
+  if(text.is_prg && !text.has_load_address && window_offset() == 0 && view_file.size >= 2) {
+    text.load_address = ((unsigned char) view_file.content[0]) | (((unsigned char) view_file.content[1]) << 8);
+    text.has_load_address = 1;
+  }
+}
+
+static unsigned row_count(void)
+{
+  return text.is_hex ? hex_row_count() : text.line_count;
+}
+
+static unsigned max_view_y(void)
+{
+  return row_count() > screen_height - 1 ? row_count() - (screen_height - 1) : 0;
+}
+
+static void set_view_y(unsigned y)
+{
+  text.view_y = y;
+  if(text.is_hex)
+    fill_hex_window(y);
+  else {
+    fill_window(y);
+    text.view_y_ptr = line_ptr(y);
+  }
+}
+
+/*
+ * A file that is viewed by a window has the line count and the maximal line length from its line
+ * checkpoints. Otherwise, the content can still be loaded and is scanned by text_append().
+ */
+void text_set(unsigned char file_type)
+{
   text.view_x = 0;
+  text.window_first_line = 0;
+  text.window_line_count = 0;
+  text.is_hex = 0;
+  text.other_view_y = 0;
+  text.is_prg = file_type == _CBM_T_PRG;
+  text.has_load_address = 0;
+  text.has_match = 0;
+  text.view_row = 0;
+  if(view_window.line_checkpoints != NULL) {
+    text.line_count = view_window.line_checkpoints[view_window.block_count] + 1;
+    text.max_line_char_count = view_window.max_line_char_count;
+    set_view_y(0);
+    update_load_address();
+    return;
+  }
+  text.window_start = view_file.content;
+  text.max_line_char_count = 0;
+  text.scanned_size = 0;
+  text.line_char_count = 0;
+  reset_index();
+  index_line(0, view_file.content);
+  text.window_line_count = 1;
+  scan_lines();
+  update_load_address();
+  text.view_y = 0;
   text.view_y_ptr = view_file.content;
 }
 
-void text_draw(void)
+/*
+ * Scans the content appended to the text and returns the first line that has changed. The
+ * content can be moved by realloc, so the pointers to it are updated.
+ */
+unsigned text_append(void)
 {
-  char *s;
-  char *end = view_file.content + view_file.size;
-  unsigned y, max_y;
-  gotoxy(0, 0);
-  if(text.view_y + screen_height - 1 <= text.line_count)
-    max_y = text.view_y + screen_height - 1;
+  unsigned y = text.is_hex ? text.scanned_size / HEX_ROW_BYTE_COUNT : text.line_count - 1;
+  text.window_start = view_file.content;
+  scan_lines();
+  update_load_address();
+  if(!text.is_hex) text.view_y_ptr = line_ptr(text.view_y);
+  return y;
+}
+
+unsigned text_line_count(void)
+{
+  return text.line_count;
+}
+
+static void draw_line(unsigned char screen_y, char *s)
+{
+  unsigned len = line_end(s) - s;
+  unsigned char count = 0;
+  screen_goto(0, screen_y);
+  if(len > text.view_x) {
+    count = umin(len - text.view_x, screen_width);
+    screen_put_chars(s + text.view_x, count);
+  }
+  screen_fill(' ', screen_width - count);
+}
+
+static char *format_hex(char *s, unsigned long x, unsigned char digit_count)
+{
+  unsigned char i;
+  for(i = digit_count; i > 0; i--) {
+    s[i - 1] = hex_digits[(unsigned char) x & 15];
+    x >>= 4;
+  }
+  return s + digit_count;
+}
+
+/*
+ * Draws the row of the hex view. The row has the offset, the address for a PRG file, the bytes
+ * in hex, and the bytes as characters.
+ */
+static void draw_hex_row(unsigned char screen_y, unsigned y)
+{
+  static char prefix[HEX_ROW_PREFIX_LEN];
+  unsigned long offset = (unsigned long) y * HEX_ROW_BYTE_COUNT;
+  char *bytes = NULL;
+  unsigned char count = 0;
+  unsigned char i;
+  char *s = prefix;
+  if(offset >= window_offset() && offset < window_offset() + view_file.size) {
+    bytes = view_file.content + (unsigned) (offset - window_offset());
+    count = umin(view_file.size - (unsigned) (offset - window_offset()), HEX_ROW_BYTE_COUNT);
+  }
+  s = format_hex(s, offset, 5);
+  *(s++) = ' ';
+  if(text.has_load_address)
+    s = format_hex(s, text.load_address + (unsigned) offset - 2, 4);
+  else {
+    memset(s, ' ', 4);
+    s += 4;
+  }
+  for(i = 0; i < HEX_ROW_BYTE_COUNT; i++) {
+    if((i & 3) == 0) *(s++) = ' ';
+    if(i < count)
+      s = format_hex(s, (unsigned char) bytes[i], 2);
+    else {
+      s[0] = s[1] = ' ';
+      s += 2;
+    }
+  }
+  *s = ' ';
+  screen_goto(0, screen_y);
+  screen_put_chars(prefix, HEX_ROW_PREFIX_LEN);
+  if(count > 0) screen_put_chars(bytes, count);
+  screen_fill(' ', screen_width - HEX_ROW_PREFIX_LEN - count);
+}
+
+static void draw_row(unsigned char screen_y, unsigned y)
+{
+  if(text.is_hex)
+    draw_hex_row(screen_y, y);
   else
-    max_y = text.line_count;
-  s = text.view_y_ptr;
-  for(y = text.view_y; y < max_y; y++) {
-    unsigned x;
-    for(x = 0; x < text.view_x; x++) {
-      if(s < end && *s != '\n') s++;
+    draw_line(screen_y, line_ptr(y));
+}
+
+/*
+ * In the wrap mode, a line is split into rows of the screen width. The view is at the row of its
+ * first line, and the rows of the lines are counted only when the view reaches them.
+ */
+static char is_wrapping(void)
+{
+  return text.is_wrapped && !text.is_hex;
+}
+
+static unsigned line_row_count(char *s)
+{
+  unsigned len = line_end(s) - s;
+  return len > 0 ? (len + screen_width - 1) / screen_width : 1;
+}
+
+static void draw_wrapped_row(unsigned char screen_y, unsigned y, char *s, unsigned row)
+{
+  unsigned char count = 0;
+  screen_goto(0, screen_y);
+  if(y < text.line_count) {
+    unsigned len = line_end(s) - s;
+    unsigned x = row * screen_width;
+    if(len > x) {
+      count = umin(len - x, screen_width);
+      screen_put_chars(s + x, count);
     }
-    for(; x < text.view_x + screen_width; x++) {
-      if(s < end && *s != '\n') {
-        safely_cputc(*s);
-        s++;
-      } else
-        cputc(' ');
+  }
+  screen_fill(' ', screen_width - count);
+}
+
+/*
+ * Finds the line and the row of the line for the row of the view.
+ */
+static void locate_row(unsigned char screen_y, unsigned *y, char **s, unsigned *row)
+{
+  *y = text.view_y;
+  *s = text.view_y_ptr;
+  *row = text.view_row;
+  for(; screen_y > 0; screen_y--) {
+    (*row)++;
+    if(*row >= line_row_count(*s)) {
+      *row = 0;
+      (*y)++;
+      *s = next_line(*s);
     }
-    if(y + 1 < max_y) {
-      while(s < end && *s != '\n') s++;
-      /* \n */
-      if(s < end) s++;
+  }
+}
+
+/*
+ * Counts the rows from the top of the view up to the limit.
+ */
+static unsigned count_rows(unsigned limit)
+{
+  unsigned y = text.view_y;
+  char *s = text.view_y_ptr;
+  unsigned rows = line_row_count(s) - text.view_row;
+  while(rows < limit && ++y < text.line_count) {
+    s = next_line(s);
+    rows += line_row_count(s);
+  }
+  return umin(rows, limit);
+}
+
+static unsigned wrap_up(unsigned count)
+{
+  unsigned steps;
+  for(steps = 0; steps < count; steps++) {
+    if(text.view_row > 0)
+      text.view_row--;
+    else if(text.view_y > 0) {
+      set_view_y(text.view_y - 1);
+      text.view_row = line_row_count(text.view_y_ptr) - 1;
+    } else
+      break;
+  }
+  return steps;
+}
+
+static unsigned wrap_down(unsigned count)
+{
+  unsigned rows = count_rows(count + screen_height - 1);
+  unsigned steps;
+  if(rows <= screen_height - 1) return 0;
+  count = umin(count, rows - (screen_height - 1));
+  for(steps = 0; steps < count; steps++) {
+    text.view_row++;
+    if(text.view_row >= line_row_count(text.view_y_ptr)) {
+      text.view_row = 0;
+      set_view_y(text.view_y + 1);
     }
   }
-  for(; y < text.view_y + screen_height - 1; y++) {
-    unsigned screen_x;
-    for(screen_x = 0; screen_x < screen_width; screen_x++) {
-      cputc(' ');
+  return steps;
+}
+
+/*
+ * Draws the column of the view at the character index of the lines.
+ */
+static void draw_column(unsigned char screen_x, unsigned x)
+{
+  char *s = text.view_y_ptr;
+  unsigned y;
+  unsigned char screen_y;
+  for(screen_y = 0, y = text.view_y; screen_y < screen_height - 1 && y < text.line_count; screen_y++, y++) {
+    char *e = line_end(s);
+    screen_goto(screen_x, screen_y);
+    screen_putc(x < (unsigned) (e - s) ? s[x] : ' ');
+    s = next_line(s);
+  }
+}
+
+void text_draw(void)
+{
+  char *s = text.view_y_ptr;
+  unsigned y;
+  unsigned row;
+  unsigned char screen_y;
+  if(is_wrapping()) {
+    y = text.view_y;
+    row = text.view_row;
+    for(screen_y = 0; screen_y < screen_height - 1; screen_y++) {
+      draw_wrapped_row(screen_y, y, s, row);
+      row++;
+      if(y < text.line_count && row >= line_row_count(s)) {
+        row = 0;
+        y++;
+        s = next_line(s);
+      }
+    }
+    return;
+  }
+  for(screen_y = 0, y = text.view_y; screen_y < screen_height - 1; screen_y++, y++) {
+    if(text.is_hex && y < hex_row_count())
+      draw_hex_row(screen_y, y);
+    else if(!text.is_hex && y < text.line_count) {
+      draw_line(screen_y, s);
+      s = next_line(s);
+    } else {
+      screen_goto(0, screen_y);
+      screen_fill(' ', screen_width);
     }
   }
 }
 
-void text_move_view_up(void)
+/*
+ * Draws the lines of the view from the line.
+ */
+void text_draw_from(unsigned y)
+{
+  unsigned char screen_y;
+  if(y >= text.view_y + screen_height - 1) return;
+  if(is_wrapping()) {
+    text_draw();
+    return;
+  }
+  if(y < text.view_y) y = text.view_y;
+  for(screen_y = y - text.view_y; screen_y < screen_height - 1 && y < row_count(); screen_y++, y++) draw_row(screen_y, y);
+}
+
+/*
+ * A movement by one line or one column shifts the screen and draws only the new line or the new
+ * column. A movement by more steps draws the whole view.
+ */
+void text_move_view_up(unsigned count)
 {
+  if(is_wrapping()) {
+    count = wrap_up(count);
+    if(count == 1) {
+      screen_scroll_down(0, 0, screen_width, screen_height - 1);
+      draw_wrapped_row(0, text.view_y, text.view_y_ptr, text.view_row);
+    } else if(count > 1)
+      text_draw();
+    return;
+  }
   if(text.view_y > 0) {
-    text.view_y--;
-    if(text.view_y_ptr > view_file.content) {
-      /* \n */
-      text.view_y_ptr--;
-      if(text.view_y_ptr > view_file.content) {
-        text.view_y_ptr--;
-        while(text.view_y_ptr > view_file.content) {
-          if(*(text.view_y_ptr) == '\n') {
-            text.view_y_ptr++;
-            break;
-          }
-          text.view_y_ptr--;
-        }
+    unsigned old_view_y = text.view_y;
+    set_view_y(text.view_y - umin(count, text.view_y));
+    if(text.view_y + 1 == old_view_y) {
+      screen_scroll_down(0, 0, screen_width, screen_height - 1);
+      draw_row(0, text.view_y);
+    } else
+      text_draw();
+  }
+}
+
+void text_move_view_down(unsigned count)
+{
+  if(is_wrapping()) {
+    count = wrap_down(count);
+    if(count == 1) {
+      unsigned y;
+      char *s;
+      unsigned row;
+      locate_row(screen_height - 2, &y, &s, &row);
+      screen_scroll_up(0, 0, screen_width, screen_height - 1);
+      draw_wrapped_row(screen_height - 2, y, s, row);
+    } else if(count > 1)
+      text_draw();
+    return;
+  }
+  if(text.view_y < max_view_y()) {
+    unsigned old_view_y = text.view_y;
+    set_view_y(umin(text.view_y + umin(count, row_count()), max_view_y()));
+    if(text.view_y == old_view_y + 1) {
+      screen_scroll_up(0, 0, screen_width, screen_height - 1);
+      draw_row(screen_height - 2, text.view_y + screen_height - 2);
+    } else
+      text_draw();
+  }
+}
+
+void text_move_view_to(unsigned y)
+{
+  text.view_row = 0;
+  set_view_y(umin(y, max_view_y()));
+  text_draw();
+}
+
+void text_move_view_to_percent(unsigned char percent)
+{
+  if(row_count() > 0)
+    text_move_view_to((unsigned) (((unsigned long) (row_count() - 1) * umin(percent, 100)) / 100));
+}
+
+/*
+ * Moves the hex view to the row of the offset.
+ */
+void text_move_view_to_offset(unsigned long offset)
+{
+  text_move_view_to((unsigned) (offset / HEX_ROW_BYTE_COUNT));
+}
+
+void text_move_view_to_end(void)
+{
+  if(is_wrapping()) {
+    set_view_y(text.line_count - 1);
+    text.view_row = line_row_count(text.view_y_ptr) - 1;
+    wrap_up(screen_height - 2);
+    text_draw();
+    return;
+  }
+  text_move_view_to(max_view_y());
+}
+
+void text_move_view_left(unsigned count)
+{
+  if(!text.is_hex && !text.is_wrapped && text.view_x > 0) {
+    unsigned old_view_x = text.view_x;
+    text.view_x -= umin(count, text.view_x);
+    if(text.view_x + 1 == old_view_x) {
+      screen_shift_right(0, 0, screen_width, screen_height - 1);
+      draw_column(0, text.view_x);
+    } else
+      text_draw();
+  }
+}
+
+void text_move_view_right(unsigned count)
+{
+  if(!text.is_hex && !text.is_wrapped && text.view_x + screen_width < text.max_line_char_count) {
+    unsigned old_view_x = text.view_x;
+    text.view_x = umin(text.view_x + count, text.max_line_char_count - screen_width);
+    if(text.view_x == old_view_x + 1) {
+      screen_shift_left(0, 0, screen_width, screen_height - 1);
+      draw_column(screen_width - 1, text.view_x + screen_width - 1);
+    } else
+      text_draw();
+  }
+}
+
+/*
+ * Switches between the text view and the hex view. Each view keeps its position.
+ */
+void text_toggle_hex(void)
+{
+  unsigned y = text.other_view_y;
+  text.other_view_y = text.view_y;
+  text.is_hex = !text.is_hex;
+  text.view_row = 0;
+  set_view_y(umin(y, max_view_y()));
+  text_draw();
+}
+
+/*
+ * Switches the wrap mode. The view stays at its line.
+ */
+void text_toggle_wrap(void)
+{
+  text.is_wrapped = !text.is_wrapped;
+  text.view_row = 0;
+  text.view_x = 0;
+  text_draw();
+}
+
+char text_is_hex(void)
+{
+  return text.is_hex;
+}
+
+/*
+ * Returns the line of the pointer to the window. The line is found by the index, so only the lines
+ * after the indexed line are counted.
+ */
+static unsigned line_of(char *p)
+{
+  char *s = text.window_start;
+  unsigned y = 0;
+  unsigned lo, hi;
+  /* The pointer can be in the line that begins before the window. */
+  if(p < text.window_start) return text.window_first_line - 1;
+  if(text.line_offsets != NULL && text.window_line_count > 0) {
+    lo = 0;
+    hi = (text.window_line_count - 1) >> text.line_offset_shift;
+    while(lo < hi) {
+      unsigned mid = lo + (hi - lo + 1) / 2;
+      if(view_file.content + text.line_offsets[mid] <= p)
+        lo = mid;
+      else
+        hi = mid - 1;
+    }
+    s = view_file.content + text.line_offsets[lo];
+    y = lo << text.line_offset_shift;
+  }
+  while(1) {
+    char *nl = memchr(s, '\n', p - s);
+    if(nl == NULL) break;
+    s = nl + 1;
+    y++;
+  }
+  return text.window_first_line + y;
+}
+
+/*
+ * Returns the row of the view that shows the row of the line in the wrap mode, or a row after the
+ * view.
+ */
+static unsigned char find_screen_row(unsigned y, unsigned row)
+{
+  unsigned view_y = text.view_y;
+  char *s = text.view_y_ptr;
+  unsigned view_row = text.view_row;
+  unsigned char screen_y;
+  for(screen_y = 0; screen_y < screen_height - 1 && view_y <= y; screen_y++) {
+    if(view_y == y && view_row == row) return screen_y;
+    view_row++;
+    if(view_row >= line_row_count(s)) {
+      view_row = 0;
+      view_y++;
+      s = next_line(s);
+    }
+  }
+  return screen_height - 1;
+}
+
+static unsigned long view_offset(void)
+{
+  if(text.is_hex) return (unsigned long) text.view_y * HEX_ROW_BYTE_COUNT;
+  return window_offset() + (text.view_y_ptr - view_file.content);
+}
+
+static unsigned match_y(void)
+{
+  return text.is_hex ? (unsigned) (text.match_offset / HEX_ROW_BYTE_COUNT) : text.match_line;
+}
+
+/*
+ * Searches the content of the window backward for the match that begins in the window before the
+ * limit.
+ */
+static char *search_window_backward(unsigned long limit)
+{
+  unsigned long end = limit - window_offset() + search_pattern_len() - 1;
+  return search_backward(view_file.content, (unsigned) (end < view_file.size ? end : view_file.size));
+}
+
+/*
+ * Searches the file forward from the offset or backward before the offset, and returns the match
+ * in the content. A file that is viewed by a window is searched window by window in one pass
+ * forward through the open file. The windows overlap by one block, so that a match across two
+ * windows isn't missed. A backward search first searches the window in memory, then passes
+ * forward from the file start to this window and remembers the last match.
+ */
+static char *search_file(unsigned long offset, char is_backward)
+{
+  unsigned char pattern_len = search_pattern_len();
+  unsigned long start;
+  unsigned long limit;
+  unsigned long match_offset;
+  char has_match;
+  unsigned block;
+  char *p;
+  if(view_window.line_checkpoints == NULL) {
+    if(is_backward)
+      return search_backward(view_file.content, (unsigned) (offset + pattern_len - 1 < view_file.size ? offset + pattern_len - 1 : view_file.size));
+    return offset < view_file.size ? search_forward(view_file.content + (unsigned) offset, view_file.size - (unsigned) offset) : NULL;
+  }
+  if(is_backward) {
+    limit = offset;
+    if(offset >= window_offset() && offset - window_offset() <= view_file.size) {
+      p = search_window_backward(offset);
+      if(p != NULL) return p;
+      /* A match before the offset that crosses the window end isn't in the content. */
+      if(offset - window_offset() + pattern_len - 1 <= view_file.size) limit = window_offset();
+    }
+    has_match = 0;
+    match_offset = 0;
+    for(block = 0; (unsigned long) block * FILE_BLOCK_SIZE < limit; block += view_window.capacity_in_blocks - 1) {
+      if(!read_window_lines(block)) return NULL;
+      p = search_window_backward(limit);
+      if(p != NULL) {
+        has_match = 1;
+        match_offset = window_offset() + (p - view_file.content);
       }
+      if(block + view_window.capacity_in_blocks >= view_window.block_count) break;
     }
-    text_draw();
+    if(!has_match) return NULL;
+    block = (unsigned) (match_offset / FILE_BLOCK_SIZE);
+    if(!read_window_lines(block - umin(block, view_window.capacity_in_blocks / 4))) return NULL;
+    return view_file.content + (unsigned) (match_offset - window_offset());
+  }
+  block = (unsigned) (offset / FILE_BLOCK_SIZE);
+  while(1) {
+    if(!read_window_lines(block)) return NULL;
+    start = offset > window_offset() ? offset - window_offset() : 0;
+    if(start < view_file.size) {
+      p = search_forward(view_file.content + (unsigned) start, view_file.size - (unsigned) start);
+      if(p != NULL) return p;
+    }
+    if(block + view_window.capacity_in_blocks >= view_window.block_count) return NULL;
+    block += view_window.capacity_in_blocks - 1;
   }
 }
 
-void text_move_view_down(void)
+/*
+ * Moves the view to the match in the content and shows the match in reverse in the text view.
+ */
+static void show_match(char *p)
 {
-  if(text.view_y + screen_height - 1 < text.line_count) {
-    char *end = view_file.content + view_file.size;
-    text.view_y++;
-    while(text.view_y_ptr < end && *(text.view_y_ptr) != '\n') {
-      text.view_y_ptr++;
+  unsigned char pattern_len = search_pattern_len();
+  unsigned x;
+  unsigned y;
+  unsigned char screen_y;
+  text.has_match = 1;
+  text.match_offset = window_offset() + (p - view_file.content);
+  if(!text.is_hex) text.match_line = line_of(p);
+  y = match_y();
+  if(y < text.view_y || y >= text.view_y + screen_height - 1) {
+    text.view_row = 0;
+    set_view_y(umin(y, max_view_y()));
+  } else
+    set_view_y(text.view_y);
+  if(text.is_hex) {
+    text_draw();
+    return;
+  }
+  x = (unsigned) (text.match_offset - window_offset() - (line_ptr(y) - view_file.content));
+  p = view_file.content + (unsigned) (text.match_offset - window_offset());
+  if(is_wrapping()) {
+    screen_y = find_screen_row(y, x / screen_width);
+    if(screen_y >= screen_height - 1) {
+      set_view_y(y);
+      text.view_row = x / screen_width;
+      screen_y = 0;
     }
-    /* \n */
-    if(text.view_y_ptr < end) text.view_y_ptr++;
     text_draw();
+    x %= screen_width;
+    screen_goto(x, screen_y);
+    screen_revers(1);
+    screen_put_chars(p, umin(pattern_len, screen_width - x));
+    screen_revers(0);
+    return;
   }
+  if(x < text.view_x || x + pattern_len > text.view_x + screen_width) {
+    text.view_x = x > screen_width / 4 ? x - screen_width / 4 : 0;
+    if(text.max_line_char_count > screen_width)
+      text.view_x = umin(text.view_x, text.max_line_char_count - screen_width);
+    else
+      text.view_x = 0;
+  }
+  text_draw();
+  screen_goto(x - text.view_x, y - text.view_y);
+  screen_revers(1);
+  screen_put_chars(p, umin(pattern_len, screen_width - (x - text.view_x)));
+  screen_revers(0);
 }
 
-void text_move_view_left(void)
+/*
+ * Searches the pattern that is set by search_set() and moves the view to the match. The next
+ * search continues from the match if the match is in the view, otherwise the search begins at the
+ * view.
+ */
+char text_search(char is_backward, char is_next)
 {
-  if(text.view_x > 0) {
-    text.view_x--;
-    text_draw();
+  unsigned long offset = view_offset();
+  char *p;
+  if(is_next && text.has_match && match_y() >= text.view_y && match_y() < text.view_y + screen_height - 1)
+    offset = text.match_offset + (is_backward ? 0 : 1);
+  p = search_file(offset, is_backward);
+  if(p == NULL) {
+    /* The window is moved back to the view. */
+    set_view_y(text.view_y);
+    return 0;
   }
+  show_match(p);
+  return 1;
 }
 
-void text_move_view_right(void)
+/*
+ * Moves the view to the match of the pattern at the offset of the file.
+ */
+char text_go_to_match(unsigned long offset)
 {
-  if(text.view_x + screen_width < text.max_line_char_count) {
-    text.view_x++;
-    text_draw();
+  if(view_window.line_checkpoints != NULL && !read_window_lines((unsigned) (offset / FILE_BLOCK_SIZE))) {
+    set_view_y(text.view_y);
+    return 0;
+  }
+  if(offset < window_offset() || offset - window_offset() >= view_file.size) {
+    set_view_y(text.view_y);
+    return 0;
   }
+  show_match(view_file.content + (unsigned) (offset - window_offset()));
+  return 1;
 }
@@ -21,11 +21,24 @@
 void initialize_text(void);
 void finalize_text(void);
 
-void text_set(void);
+void text_set(unsigned char file_type);
+void text_free(void);
+unsigned text_append(void);
+unsigned text_line_count(void);
 void text_draw(void);
-void text_move_view_up(void);
-void text_move_view_down(void);
-void text_move_view_left(void);
-void text_move_view_right(void);
+void text_draw_from(unsigned y);
+void text_move_view_up(unsigned count);
+void text_move_view_down(unsigned count);
+void text_move_view_to(unsigned y);
+void text_move_view_to_percent(unsigned char percent);
+void text_move_view_to_offset(unsigned long offset);
+void text_move_view_to_end(void);
+void text_move_view_left(unsigned count);
+void text_move_view_right(unsigned count);
+void text_toggle_hex(void);
+void text_toggle_wrap(void);
+char text_is_hex(void);
+char text_search(char is_backward, char is_next);
+char text_go_to_match(unsigned long offset);
 
 #endif
@@ -15,12 +15,15 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <6502.h>
 #include <conio.h>
-#include <ctype.h>
 #include <string.h>
 #include "screen.h"
 #include "util.h"
 
+#define KEY_COUNT                       (*((unsigned char *) 0xc6))
+#define KEY_BUFFER                      ((unsigned char *) 0x0277)
+
 int max(int x, int y)
 { return x < y ? y : x; } 
 
@@ -45,28 +48,77 @@ unsigned char center(unsigned char n, unsigned char i)
 unsigned char even(unsigned char i)
 { return ((i + 1) >> 1) << 1; }
 
-void safely_cputc(char c)
+char check_file_name(const char *file_name)
 {
-  if(!iscntrl(c))
-    cputc(c);
-  else
-    cputc('.');
+  const char *s = file_name;
+  while(*s) {
+    if(strchr("\"*,:=?@", *s) != NULL) return 0;
+    s++;
+  }
+  return 1;
 }
 
-void safely_cputs(const char *s)
+/*
+ * Patterns have the same meaning as patterns of CBM DOS. The '?' character matches any character
+ * and the '*' character matches the rest of file name.
+ */
+char match_pattern(const char *pattern, const char *file_name)
 {
-  while(*s != 0) {
-    safely_cputc(*s);
-    s++;
+  while(*pattern != 0) {
+    if(*pattern == '*') return 1;
+    if(*file_name == 0) return 0;
+    if(*pattern != '?' && *pattern != *file_name) return 0;
+    pattern++;
+    file_name++;
   }
+  return *file_name == 0;
 }
 
-char check_file_name(const char *file_name)
+unsigned crc16_update(unsigned crc, const char *buf, unsigned size)
 {
-  const char *s = file_name;
-  while(*s) {
-    if(strchr("\"*,:=?@", *s) != NULL) return 0;
-    s++;
+  while(size > 0) {
+    unsigned char x = ((unsigned char) (crc >> 8)) ^ ((unsigned char) *buf);
+    x ^= x >> 4;
+    crc = (crc << 8) ^ (((unsigned) x) << 12) ^ (((unsigned) x) << 5) ^ x;
+    buf++;
+    size--;
   }
-  return 1;
+  return crc;
+}
+
+/*
+ * Removes the next presses of the key from the keyboard buffer of the KERNAL and returns the number
+ * of presses with the already read press. Queued repeats of a movement key can be handled as one
+ * movement with one redraw.
+ */
+unsigned char drain_key(char c)
+{
+  unsigned char count = 1;
+  while(KEY_COUNT > 0 && KEY_BUFFER[0] == (unsigned char) c) {
+    cgetc();
+    count++;
+  }
+  return count;
+}
+
+/*
+ * Takes the key from the keyboard buffer of the KERNAL if the key is anywhere in the buffer. Only
+ * the first entry of the key is removed and other keys are kept in their order, so they aren't lost.
+ * The interrupts are disabled because the keyboard buffer is filled by the interrupt handler.
+ * Returns non-zero if the key is taken.
+ */
+char take_key(char c)
+{
+  unsigned char i;
+  SEI();
+  for(i = 0; i < KEY_COUNT; i++) {
+    if(KEY_BUFFER[i] == (unsigned char) c) {
+      KEY_COUNT--;
+      for(; i < KEY_COUNT; i++) KEY_BUFFER[i] = KEY_BUFFER[i + 1];
+      CLI();
+      return 1;
+    }
+  }
+  CLI();
+  return 0;
 }
@@ -18,6 +18,8 @@
 #ifndef _UTIL_H
 #define _UTIL_H
 
+#define CRC16_INITIAL_VALUE             0xffff
+
 int max(int x, int y);
 int min(int x, int y);
 unsigned umax(unsigned x, unsigned y);
@@ -26,8 +28,10 @@ unsigned char center_x(unsigned char width);
 unsigned char center_y(unsigned char height);
 unsigned char center(unsigned char n, unsigned char i);
 unsigned char even(unsigned char i);
-void safely_cputc(char c);
-void safely_cputs(const char *s);
 char check_file_name(const char *file_name);
+char match_pattern(const char *pattern, const char *file_name);
+unsigned crc16_update(unsigned crc, const char *buf, unsigned size);
+unsigned char drain_key(char c);
+char take_key(char c);
 
 #endif
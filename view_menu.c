@@ -16,50 +16,212 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include <conio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "dialog.h"
+#include "file.h"
+#include "job.h"
 #include "screen.h"
+#include "search.h"
 #include "text.h"
 #include "util.h"
 #include "view_menu.h"
 
+#define HELP_LABEL_COUNT                11
+
 void view_menu_draw(void)
 {
-  char *menu = "A-About Q-Quit                          ";
+  char *menu = "F1/F7-Page /-Find X-Hex H-Help Q-Quit   ";
   size_t len = strlen(menu);
-  gotoxy(center_x(len), screen_height - VIEW_MENU_HEIGHT);
-  cputs(menu);
+  screen_goto(center_x(len), screen_height - VIEW_MENU_HEIGHT);
+  screen_puts(menu);
+}
+
+static void show_help(void)
+{
+  static const char *labels[HELP_LABEL_COUNT] = {
+    "Cursor keys Scroll",
+    "F1 Page up         F7 Page down",
+    "HOME Top           E End",
+    "G Go to line or offset",
+    "% Go to percent",
+    "/ Search           ? Search backward",
+    ". Next match       , Previous match",
+    "X Hex or text view",
+    "W Wrap lines",
+    "A About",
+    "RUN/STOP/Q Quit"
+  };
+  help_dialog_set("Help", labels, HELP_LABEL_COUNT);
+  help_dialog_draw();
+  help_dialog_loop();
+}
+
+/*
+ * Goes to the line in the text view or to the hex offset in the hex view.
+ */
+static void go_to_line(void)
+{
+  static char line_buf[6];
+  static struct input inputs[1] = {
+    {
+      NULL,
+      line_buf,
+      5
+    }
+  };
+  unsigned line;
+  line_buf[0] = 0;
+  inputs[0].label = text_is_hex() ? "Hex offset:" : "Line:";
+  input_dialog_set("Go to", inputs, 1);
+  input_dialog_draw();
+  if(!input_dialog_loop()) return;
+  if(text_is_hex()) {
+    text_move_view_to_offset(strtoul(line_buf, NULL, 16));
+    return;
+  }
+  line = atoi(line_buf);
+  text_move_view_to(line > 0 ? line - 1 : 0);
+}
+
+static void go_to_percent(void)
+{
+  static char percent_buf[4];
+  static struct input inputs[1] = {
+    {
+      "Percent:",
+      percent_buf,
+      3
+    }
+  };
+  percent_buf[0] = 0;
+  input_dialog_set("Go to", inputs, 1);
+  input_dialog_draw();
+  if(!input_dialog_loop()) return;
+  text_move_view_to_percent(atoi(percent_buf));
+}
+
+/*
+ * Loads the next block of the viewed file and draws the lines that have changed.
+ */
+static void load_next_block(void)
+{
+  const char *error;
+  int res = file_load_next(&view_file, &error);
+  if(res == -1) {
+    file_load_close();
+    message_dialog_set("Error", error);
+    message_dialog_draw();
+    message_dialog_loop();
+  } else if(res == 0)
+    file_load_close();
+  else
+    text_draw_from(text_append());
+}
+
+static void search(char is_backward, char is_next)
+{
+  static char pattern[SEARCH_PATTERN_MAX + 1];
+  static struct input inputs[1] = {
+    {
+      "Pattern:",
+      pattern,
+      SEARCH_PATTERN_MAX
+    }
+  };
+  if(!is_next || search_pattern_len() == 0) {
+    input_dialog_set(is_backward ? "Search backward" : "Search", inputs, 1);
+    input_dialog_draw();
+    if(!input_dialog_loop() || pattern[0] == 0) return;
+    search_set(pattern);
+  }
+  if(!text_search(is_backward, is_next)) {
+    message_dialog_set("Search", "Pattern not found");
+    message_dialog_draw();
+    message_dialog_loop();
+  }
 }
 
-static void redraw()
+static void show_job_message(void)
 {
-  screen_clear();
-  view_menu_draw();
-  text_draw();
+  const char *title;
+  const char *msg = job_message(&title);
+  if(msg != NULL) {
+    message_dialog_set(title, msg);
+    message_dialog_draw();
+    message_dialog_loop();
+  }
 }
 
 void view_menu_loop(void)
 {
   char is_exit = 0;
   while(!is_exit) {
+    show_job_message();
+    if(file_is_loading() && !kbhit()) {
+      load_next_block();
+      continue;
+    }
+    if(job_is_running() && !kbhit()) {
+      job_step();
+      continue;
+    }
     switch(cgetc()) {
     case CH_CURS_UP:
-      text_move_view_up();
+      text_move_view_up(drain_key(CH_CURS_UP));
       break;
     case CH_CURS_DOWN:
-      text_move_view_down();
+      text_move_view_down(drain_key(CH_CURS_DOWN));
       break;
     case CH_CURS_LEFT:
-      text_move_view_left();
+      text_move_view_left(drain_key(CH_CURS_LEFT));
       break;
     case CH_CURS_RIGHT:
-      text_move_view_right();
+      text_move_view_right(drain_key(CH_CURS_RIGHT));
+      break;
+    case CH_F1:
+      text_move_view_up(drain_key(CH_F1) * (screen_height - VIEW_MENU_HEIGHT));
+      break;
+    case CH_F7:
+      text_move_view_down(drain_key(CH_F7) * (screen_height - VIEW_MENU_HEIGHT));
+      break;
+    case CH_HOME:
+      text_move_view_to(0);
+      break;
+    case 'e':
+      text_move_view_to_end();
+      break;
+    case 'g':
+      go_to_line();
+      break;
+    case '%':
+      go_to_percent();
+      break;
+    case '/':
+      search(0, 0);
+      break;
+    case '?':
+      search(1, 0);
+      break;
+    case '.':
+      search(0, 1);
+      break;
+    case ',':
+      search(1, 1);
+      break;
+    case 'x':
+      text_toggle_hex();
+      break;
+    case 'w':
+      text_toggle_wrap();
+      break;
+    case 'h':
+      show_help();
       break;
     case 'a':
       about_dialog_set();
       about_dialog_draw();
       about_dialog_loop();
-      redraw();
       break;
     case CH_STOP:
     case CH_ESC: